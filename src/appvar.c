@@ -52,6 +52,43 @@ static unsigned int appvar_checksum(unsigned char *arr, size_t size)
 	return checksum;
 }
 
+/*
+ * Checks if the AppVar data is compressed as a whole.
+ * With compressGroups only the image groups inside it are compressed.
+ */
+bool appvar_is_compressed(const appvar_t *a)
+{
+    return a->compress != COMPRESS_NONE && !a->compressGroups;
+}
+
+/*
+ * Compresses the AppVar data before it is written.
+ * Resolves an automatic compression mode to the format used.
+ */
+int appvar_compress(appvar_t *a)
+{
+    size_t size = a->size;
+    int ret;
+
+    if (!appvar_is_compressed(a))
+    {
+        return 0;
+    }
+
+    a->compressAuto = a->compress == COMPRESS_AUTO;
+
+    ret = compress_array(&a->data, &size, &a->compress, a->compressLevel);
+    if (ret != 0)
+    {
+        LL_ERROR("Failed to compress data for AppVar \'%s\'.", a->name);
+        return ret;
+    }
+
+    a->size = size;
+
+    return 0;
+}
+
 /*
  * Exports data to TI AppVar format.
  */
@@ -67,22 +104,8 @@ int appvar_write(appvar_t *a, FILE *fdv)
     size_t data_size;
     size_t varb_size;
     size_t var_size;
-    size_t size;
     int ret = 0;
 
-    size = a->size;
-
-    if (a->compress != COMPRESS_NONE)
-    {
-        ret = compress_array(&a->data, &size, a->compress);
-        if (ret != 0)
-        {
-            LL_ERROR("Failed to compress data for AppVar \'%s\'.", a->name);
-            return ret;
-        }
-        a->size = size;
-    }
-
     if (a->size > APPVAR_MAX_DATA_SIZE)
     {
         LL_ERROR("Too much data for AppVar \'%s\'.", a->name);
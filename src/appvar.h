@@ -36,6 +36,7 @@ extern "C" {
 #endif
 
 #include "compress.h"
+#include "tileset.h"
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -71,6 +72,13 @@ typedef enum
     APPVAR_SOURCE_ICE,
 } appvar_source_t;
 
+/* per tile compressed copy of a tileset, owned by the AppVar */
+typedef struct
+{
+    const tileset_t *source;
+    tileset_t copy;
+} appvar_tileset_t;
+
 typedef struct
 {
     char *name;
@@ -78,14 +86,21 @@ typedef struct
     appvar_source_t source;
     bool init;
     compress_t compress;
+    compress_level_t compressLevel;
+    bool compressGroups;
     uint8_t *data;
     int size;
     int numEntries;
 
     /* set by output */
     char *directory;
+    bool compressAuto;
+    appvar_tileset_t *tilesets;
+    int numTilesets;
 } appvar_t;
 
+bool appvar_is_compressed(const appvar_t *a);
+int appvar_compress(appvar_t *a);
 int appvar_write(appvar_t *a, FILE *fdv);
 
 #ifdef __cplusplus
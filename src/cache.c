@@ -0,0 +1,405 @@
+/*
+ * Copyright 2017-2019 Matt "MateoConLechuga" Waltz
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cache.h"
+#include "thread.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#define CACHE_MAGIC "CVCACHE"
+#define CACHE_VERSION 4
+
+#define CACHE_FNV_OFFSET 0xcbf29ce484222325ULL
+#define CACHE_FNV_PRIME 0x100000001b3ULL
+
+static char *cache_dir = NULL;
+static unsigned int cache_hits = 0;
+static unsigned int cache_misses = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Sets the directory used for cached conversions, NULL disables.
+ */
+void cache_set_dir(const char *dir)
+{
+    free(cache_dir);
+    cache_dir = dir == NULL ? NULL : strdup(dir);
+}
+
+/*
+ * Returns true if a cache directory is in use.
+ */
+bool cache_enabled(void)
+{
+    return cache_dir != NULL;
+}
+
+/*
+ * Starts a new key for a type of cached data.
+ */
+void cache_key_init(cache_key_t *key, const char *type)
+{
+    int version = CACHE_VERSION;
+
+    key->hash = CACHE_FNV_OFFSET;
+    cache_key_add(key, type, strlen(type) + 1);
+    cache_key_add(key, &version, sizeof version);
+}
+
+/*
+ * Adds data to a key (FNV-1a).
+ */
+void cache_key_add(cache_key_t *key, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    uint64_t hash = key->hash;
+    size_t i;
+
+    for (i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= CACHE_FNV_PRIME;
+    }
+
+    key->hash = hash;
+}
+
+/*
+ * Adds an integer to a key.
+ */
+void cache_key_add_int(cache_key_t *key, int value)
+{
+    int32_t tmp = value;
+
+    cache_key_add(key, &tmp, sizeof tmp);
+}
+
+/*
+ * Adds the contents of a file to a key.
+ */
+int cache_key_add_file(cache_key_t *key, const char *path)
+{
+    uint8_t buf[65536];
+    size_t total = 0;
+    size_t len;
+    FILE *fd;
+
+    fd = fopen(path, "rb");
+    if (fd == NULL)
+    {
+        return 1;
+    }
+
+    while ((len = fread(buf, 1, sizeof buf, fd)) > 0)
+    {
+        cache_key_add(key, buf, len);
+        total += len;
+    }
+
+    fclose(fd);
+
+    cache_key_add(key, &total, sizeof total);
+
+    return 0;
+}
+
+/*
+ * Builds the path of a cache entry.
+ */
+static char *cache_path(const cache_key_t *key, const char *ext, const char *suffix)
+{
+    size_t len = strlen(cache_dir) + strlen(ext) + strlen(suffix) + 32;
+    char *path = malloc(len);
+
+    if (path != NULL)
+    {
+        snprintf(path, len, "%s/%016llx.%s%s",
+            cache_dir,
+            (unsigned long long)key->hash,
+            ext,
+            suffix);
+    }
+
+    return path;
+}
+
+/*
+ * Counts a cache lookup.
+ */
+static void cache_count(bool hit)
+{
+    pthread_mutex_lock(&cache_lock);
+
+    if (hit)
+    {
+        cache_hits++;
+    }
+    else
+    {
+        cache_misses++;
+    }
+
+    pthread_mutex_unlock(&cache_lock);
+}
+
+/*
+ * Loads a cache entry into a blob, returns 0 on hit.
+ */
+int cache_load(const cache_key_t *key, const char *ext, cache_blob_t *blob)
+{
+    char magic[sizeof CACHE_MAGIC];
+    int version;
+    char *path;
+    FILE *fd;
+    long size;
+
+    blob->data = NULL;
+    blob->size = 0;
+    blob->offset = 0;
+
+    path = cache_path(key, ext, "");
+    if (path == NULL)
+    {
+        return 1;
+    }
+
+    fd = fopen(path, "rb");
+    free(path);
+    if (fd == NULL)
+    {
+        cache_count(false);
+        return 1;
+    }
+
+    if (fread(magic, sizeof magic, 1, fd) != 1 ||
+        memcmp(magic, CACHE_MAGIC, sizeof magic) ||
+        fread(&version, sizeof version, 1, fd) != 1 ||
+        version != CACHE_VERSION ||
+        fseek(fd, 0, SEEK_END) != 0 ||
+        (size = ftell(fd)) < 0)
+    {
+        goto error;
+    }
+
+    blob->size = size - sizeof magic - sizeof version;
+    blob->data = malloc(blob->size + 1);
+    if (blob->data == NULL ||
+        fseek(fd, sizeof magic + sizeof version, SEEK_SET) != 0 ||
+        fread(blob->data, 1, blob->size, fd) != blob->size)
+    {
+        goto error;
+    }
+
+    fclose(fd);
+    cache_count(true);
+    return 0;
+
+error:
+    LL_DEBUG("Ignoring invalid cache entry %016llx.%s",
+        (unsigned long long)key->hash, ext);
+    cache_blob_free(blob);
+    fclose(fd);
+    cache_count(false);
+    return 1;
+}
+
+/*
+ * Stores a blob as a cache entry.
+ */
+int cache_store(const cache_key_t *key, const char *ext, const cache_blob_t *blob)
+{
+    char suffix[32];
+    int version = CACHE_VERSION;
+    char *tmpPath;
+    char *path;
+    FILE *fd;
+    int ret = 1;
+
+#ifdef _WIN32
+    _mkdir(cache_dir);
+#else
+    mkdir(cache_dir, 0777);
+#endif
+
+    /* write to a temporary file so readers never see partial entries,
+       named per process and thread as builds may share the cache */
+    snprintf(suffix, sizeof suffix, ".tmp%ld.%d", (long)getpid(), thread_index());
+
+    path = cache_path(key, ext, "");
+    tmpPath = cache_path(key, ext, suffix);
+    if (path == NULL || tmpPath == NULL)
+    {
+        goto error;
+    }
+
+    fd = fopen(tmpPath, "wb");
+    if (fd == NULL)
+    {
+        LL_WARNING("Could not write cache entry \'%s\': %s",
+            tmpPath, strerror(errno));
+        goto error;
+    }
+
+    if (fwrite(CACHE_MAGIC, sizeof CACHE_MAGIC, 1, fd) == 1 &&
+        fwrite(&version, sizeof version, 1, fd) == 1 &&
+        fwrite(blob->data, 1, blob->size, fd) == blob->size)
+    {
+        ret = 0;
+    }
+
+    if (fclose(fd) != 0)
+    {
+        ret = 1;
+    }
+
+    if (ret == 0)
+    {
+        remove(path);
+        ret = rename(tmpPath, path) == 0 ? 0 : 1;
+    }
+
+    if (ret != 0)
+    {
+        remove(tmpPath);
+    }
+
+error:
+    free(tmpPath);
+    free(path);
+    return ret;
+}
+
+/*
+ * Appends data to a blob.
+ */
+int cache_blob_write(cache_blob_t *blob, const void *data, size_t size)
+{
+    uint8_t *tmp;
+
+    tmp = realloc(blob->data, blob->size + size + 1);
+    if (tmp == NULL)
+    {
+        return 1;
+    }
+
+    blob->data = tmp;
+    memcpy(blob->data + blob->size, data, size);
+    blob->size += size;
+
+    return 0;
+}
+
+/*
+ * Appends an integer to a blob.
+ */
+int cache_blob_write_int(cache_blob_t *blob, int value)
+{
+    int32_t tmp = value;
+
+    return cache_blob_write(blob, &tmp, sizeof tmp);
+}
+
+/*
+ * Reads data from a blob, fails if not enough remains.
+ */
+int cache_blob_read(cache_blob_t *blob, void *data, size_t size)
+{
+    if (size > blob->size - blob->offset)
+    {
+        return 1;
+    }
+
+    memcpy(data, blob->data + blob->offset, size);
+    blob->offset += size;
+
+    return 0;
+}
+
+/*
+ * Reads an integer from a blob.
+ */
+int cache_blob_read_int(cache_blob_t *blob, int *value)
+{
+    int32_t tmp;
+
+    if (cache_blob_read(blob, &tmp, sizeof tmp) != 0)
+    {
+        return 1;
+    }
+
+    *value = tmp;
+
+    return 0;
+}
+
+/*
+ * Frees blob data.
+ */
+void cache_blob_free(cache_blob_t *blob)
+{
+    free(blob->data);
+    blob->data = NULL;
+    blob->size = 0;
+    blob->offset = 0;
+}
+
+/*
+ * Logs cache hit/miss statistics.
+ */
+void cache_log_stats(void)
+{
+    if (!cache_enabled())
+    {
+        return;
+    }
+
+    LL_INFO("Cache: %u hit(s), %u miss(es)", cache_hits, cache_misses);
+}
+
+/*
+ * Releases the cache directory.
+ */
+void cache_free(void)
+{
+    cache_set_dir(NULL);
+}
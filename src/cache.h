@@ -0,0 +1,74 @@
+/*
+ * Copyright 2017-2019 Matt "MateoConLechuga" Waltz
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    uint64_t hash;
+} cache_key_t;
+
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+    size_t offset;
+} cache_blob_t;
+
+void cache_set_dir(const char *dir);
+bool cache_enabled(void);
+void cache_key_init(cache_key_t *key, const char *type);
+void cache_key_add(cache_key_t *key, const void *data, size_t size);
+void cache_key_add_int(cache_key_t *key, int value);
+int cache_key_add_file(cache_key_t *key, const char *path);
+int cache_load(const cache_key_t *key, const char *ext, cache_blob_t *blob);
+int cache_store(const cache_key_t *key, const char *ext, const cache_blob_t *blob);
+int cache_blob_write(cache_blob_t *blob, const void *data, size_t size);
+int cache_blob_write_int(cache_blob_t *blob, int value);
+int cache_blob_read(cache_blob_t *blob, void *data, size_t size);
+int cache_blob_read_int(cache_blob_t *blob, int *value);
+void cache_blob_free(cache_blob_t *blob);
+void cache_log_stats(void);
+void cache_free(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
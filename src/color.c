@@ -32,6 +32,29 @@
 #include "math.h"
 
 #include <stdbool.h>
+#include <pthread.h>
+
+/* 8-bit channel -> nearest 5/6-bit level -> back to 8 bits */
+static uint8_t color_table_5[256];
+static uint8_t color_table_6[256];
+static pthread_once_t color_table_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Fills the channel tables, integer forms of the rounding below.
+ */
+static void color_table_init(void)
+{
+    int i;
+
+    for (i = 0; i < 256; ++i)
+    {
+        int c5 = (i * 31 + 127) / 255;
+        int c6 = (i * 63 + 127) / 255;
+
+        color_table_5[i] = (c5 * 255 + 15) / 31;
+        color_table_6[i] = (c6 * 255 + 31) / 63;
+    }
+}
 
 /*
  * Color conversion functions
@@ -77,3 +100,29 @@ void color_convert(color_t *color, color_mode_t mode)
             break;
     }
 }
+
+/*
+ * Converts a buffer of RGBA pixels to the nearest target colors in place.
+ * Equivalent to color_convert on every pixel, alpha is set opaque.
+ */
+void color_convert_buffer(uint8_t *data, size_t numPixels, color_mode_t mode)
+{
+    size_t i;
+
+    switch (mode)
+    {
+        case COLOR_MODE_1555_GRGB:
+        case COLOR_MODE_1555_GBGR:
+            pthread_once(&color_table_once, color_table_init);
+
+            for (i = 0; i < numPixels; ++i)
+            {
+                data[0] = color_table_5[data[0]];
+                data[1] = color_table_6[data[1]];
+                data[2] = color_table_5[data[2]];
+                data[3] = 255;
+                data += 4;
+            }
+            break;
+    }
+}
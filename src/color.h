@@ -34,6 +34,7 @@
 #include "deps/libimagequant/libimagequant.h"
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -52,6 +53,7 @@ typedef struct
 } color_t;
 
 void color_convert(color_t *color, color_mode_t mode);
+void color_convert_buffer(uint8_t *data, size_t numPixels, color_mode_t mode);
 
 #ifdef __cplusplus
 }
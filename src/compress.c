@@ -29,60 +29,317 @@
  */
 
 #include "compress.h"
+#include "thread.h"
+#include "lz4.h"
 #include "log.h"
 
 #include "deps/zx7/zx7.h"
+#include "deps/zx0/zx0.h"
 
+#include <limits.h>
 #include <string.h>
 
-static int compress_zx7(unsigned char **arr, size_t *size)
+typedef struct
 {
-    long delta;
+    const char *name;
+    int (*compress)(unsigned char **arr, size_t *size, compress_level_t level);
+} compress_backend_t;
+
+/* match finder scratch is kept per thread and reused between arrays */
+static zx7_t compress_zx7_ctx[THREAD_MAX_COUNT];
+static zx0_t compress_zx0_ctx[THREAD_MAX_COUNT];
+static lz4_t compress_lz4_ctx[THREAD_MAX_COUNT];
+
+static int compress_zx7(unsigned char **arr, size_t *size, compress_level_t level)
+{
+    zx7_t *ctx = &compress_zx7_ctx[thread_index()];
     Optimal *opt;
     unsigned char *compressed;
+    size_t compressedSize;
 
-    if (size == NULL || arr == NULL)
+    if (level == COMPRESS_LEVEL_FAST)
     {
-        LL_DEBUG("invalid param in %s.", __func__);
+        opt = zx7_optimize_fast(ctx, *arr, *size);
+    }
+    else
+    {
+        opt = zx7_optimize(ctx, *arr, *size);
+    }
+    if (opt == NULL)
+    {
+        LL_ERROR("Memory error during zx7 compression.");
+        return 1;
+    }
+
+    compressed = zx7_compress(ctx, opt, *arr, *size, &compressedSize);
+    free(opt);
+    if (compressed == NULL)
+    {
+        LL_ERROR("Memory error during zx7 compression.");
         return 1;
     }
 
-    opt = optimize(*arr, *size);
-    compressed = compress(opt, *arr, *size, size, &delta);
     free(*arr);
     *arr = compressed;
+    *size = compressedSize;
+
+    return 0;
+}
+
+/*
+ * The fast level limits offsets to the zx7 window, like zx0's quick mode.
+ */
+static int compress_zx0(unsigned char **arr, size_t *size, compress_level_t level)
+{
+    zx0_t *ctx = &compress_zx0_ctx[thread_index()];
+    BLOCK *opt;
+    unsigned char *compressed;
+    int compressedSize;
 
-    if (delta < 0)
+    if (*size > INT_MAX)
     {
-        /* send warning to user? */
+        LL_ERROR("Too much data for zx0 compression.");
+        return 1;
     }
 
-    free(opt);
+    opt = zx0_optimize(ctx, *arr, (int)*size,
+        level == COMPRESS_LEVEL_FAST ? MAX_OFFSET_ZX7 : MAX_OFFSET_ZX0);
+    compressed = zx0_compress(ctx, opt, *arr, (int)*size, &compressedSize);
+    if (compressed == NULL)
+    {
+        LL_ERROR("Memory error during zx0 compression.");
+        return 1;
+    }
+
+    free(*arr);
+    *arr = compressed;
+    *size = compressedSize;
+
     return 0;
 }
 
+static int compress_lz4(unsigned char **arr, size_t *size, compress_level_t level)
+{
+    uint8_t *compressed;
+    size_t compressedSize;
+
+    if (lz4_compress(&compress_lz4_ctx[thread_index()],
+                     *arr, *size, level == COMPRESS_LEVEL_FAST,
+                     &compressed, &compressedSize))
+    {
+        LL_ERROR("Memory error during lz4 compression.");
+        return 1;
+    }
+
+    free(*arr);
+    *arr = compressed;
+    *size = compressedSize;
+
+    return 0;
+}
+
+static const compress_backend_t compress_backends[] =
+{
+    [COMPRESS_NONE] = { "none", NULL },
+    [COMPRESS_ZX7] = { "zx7", compress_zx7 },
+    [COMPRESS_ZX0] = { "zx0", compress_zx0 },
+    [COMPRESS_LZ4] = { "lz4", compress_lz4 },
+    [COMPRESS_AUTO] = { "auto", NULL },
+};
+
+/* auto keeps the fastest format within 1/16 of the smallest output */
+#define COMPRESS_AUTO_TOLERANCE 16
+
+/* formats in order of decompression speed, fastest first */
+static const compress_t compress_auto_order[] =
+{
+    COMPRESS_NONE,
+    COMPRESS_LZ4,
+    COMPRESS_ZX7,
+    COMPRESS_ZX0,
+};
+
+typedef struct
+{
+    const unsigned char *data;
+    size_t size;
+    compress_level_t level;
+    unsigned char *arr[COMPRESS_AUTO];
+    size_t sizes[COMPRESS_AUTO];
+} compress_auto_job_t;
+
 /*
- * Compress output array before writing to output.
- * Returns compressed array, or NULL if error.
+ * Compresses a copy of the data with a single backend, used as a thread job.
+ * zx0 is limited to the zx7 window here, as a full window parse of a large
+ * image can take minutes. Ask for zx0 directly to get the full window.
+ */
+static int compress_auto_try(void *arg, int index)
+{
+    compress_auto_job_t *job = arg;
+    compress_t mode = COMPRESS_NONE + 1 + index;
+    compress_level_t level = job->level;
+
+    if (mode == COMPRESS_ZX0)
+    {
+        level = COMPRESS_LEVEL_FAST;
+    }
+
+    job->arr[mode] = malloc(job->size);
+    if (job->arr[mode] == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    memcpy(job->arr[mode], job->data, job->size);
+    job->sizes[mode] = job->size;
+
+    return compress_backends[mode].compress(&job->arr[mode],
+                                            &job->sizes[mode],
+                                            level);
+}
+
+/*
+ * Tries every backend at once and keeps the best result, which may be
+ * the uncompressed data. The chosen format is stored in mode.
  */
-int compress_array(unsigned char **arr, size_t *size, compress_t mode)
+static int compress_auto(unsigned char **arr, size_t *size, compress_t *mode, compress_level_t level)
 {
-    int ret = 0;
+    compress_auto_job_t job;
+    compress_t best = COMPRESS_NONE;
+    size_t smallest;
+    size_t budget;
+    unsigned int i;
+    int ret;
+
+    memset(&job, 0, sizeof job);
+    job.data = *arr;
+    job.size = *size;
+    job.level = level;
+    job.sizes[COMPRESS_NONE] = *size;
 
-    switch (mode)
+    ret = thread_run(compress_auto_try, &job, COMPRESS_AUTO - COMPRESS_NONE - 1);
+    if (ret == 0)
     {
-        case COMPRESS_NONE:
-            ret = 0;
-            break;
+        smallest = *size;
+        for (i = COMPRESS_NONE + 1; i < COMPRESS_AUTO; ++i)
+        {
+            if (job.sizes[i] < smallest)
+            {
+                smallest = job.sizes[i];
+            }
+        }
 
-        case COMPRESS_ZX7:
-            ret = compress_zx7(arr, size);
-            break;
+        budget = smallest + smallest / COMPRESS_AUTO_TOLERANCE;
+        for (i = 0; i < sizeof compress_auto_order / sizeof compress_auto_order[0]; ++i)
+        {
+            if (job.sizes[compress_auto_order[i]] <= budget)
+            {
+                best = compress_auto_order[i];
+                break;
+            }
+        }
 
-        case COMPRESS_INVALID:
-            ret = 1;
-            break;
+        if (best != COMPRESS_NONE)
+        {
+            free(*arr);
+            *arr = job.arr[best];
+            *size = job.sizes[best];
+            job.arr[best] = NULL;
+        }
+
+        *mode = best;
+    }
+
+    for (i = 0; i < COMPRESS_AUTO; ++i)
+    {
+        free(job.arr[i]);
     }
 
     return ret;
 }
+
+/*
+ * Gets a compression mode from its name.
+ * Returns COMPRESS_INVALID if the name is unknown.
+ */
+compress_t compress_from_name(const char *name)
+{
+    int i;
+
+    if (name == NULL)
+    {
+        return COMPRESS_INVALID;
+    }
+
+    for (i = 0; i < COMPRESS_INVALID; ++i)
+    {
+        if (!strcmp(name, compress_backends[i].name))
+        {
+            return i;
+        }
+    }
+
+    return COMPRESS_INVALID;
+}
+
+/*
+ * Gets the name of a compression mode.
+ */
+const char *compress_name(compress_t mode)
+{
+    if ((unsigned int)mode >= COMPRESS_INVALID)
+    {
+        return "invalid";
+    }
+
+    return compress_backends[mode].name;
+}
+
+/*
+ * Compress output array before writing to output.
+ * Replaces the array with the compressed data; returns 0 on success.
+ * COMPRESS_AUTO in mode is replaced with the format that was chosen.
+ */
+int compress_array(unsigned char **arr, size_t *size, compress_t *mode, compress_level_t level)
+{
+    if (size == NULL || arr == NULL || mode == NULL ||
+        (unsigned int)*mode >= COMPRESS_INVALID)
+    {
+        LL_DEBUG("invalid param in %s.", __func__);
+        return 1;
+    }
+
+    if (*mode == COMPRESS_NONE)
+    {
+        return 0;
+    }
+
+    if (*size == 0)
+    {
+        LL_ERROR("Cannot compress empty data.");
+        return 1;
+    }
+
+    if (*mode == COMPRESS_AUTO)
+    {
+        return compress_auto(arr, size, mode, level);
+    }
+
+    return compress_backends[*mode].compress(arr, size, level);
+}
+
+/*
+ * Releases the compression scratch buffers of all threads.
+ */
+void compress_free(void)
+{
+    int i;
+
+    for (i = 0; i < THREAD_MAX_COUNT; ++i)
+    {
+        zx7_free(&compress_zx7_ctx[i]);
+        zx0_free(&compress_zx0_ctx[i]);
+        lz4_free(&compress_lz4_ctx[i]);
+    }
+}
@@ -41,10 +41,24 @@ typedef enum
 {
     COMPRESS_NONE,
     COMPRESS_ZX7,
+    COMPRESS_ZX0,
+    COMPRESS_LZ4,
+    COMPRESS_AUTO,
     COMPRESS_INVALID,
 } compress_t;
 
-int compress_array(unsigned char **arr, size_t *size, compress_t mode);
+typedef enum
+{
+    COMPRESS_LEVEL_OPTIMAL,
+    COMPRESS_LEVEL_FAST,
+    COMPRESS_LEVEL_INVALID,
+} compress_level_t;
+
+compress_t compress_from_name(const char *name);
+const char *compress_name(compress_t mode);
+int compress_array(unsigned char **arr, size_t *size, compress_t *mode, compress_level_t level);
+
+void compress_free(void);
 
 #ifdef __cplusplus
 }
@@ -31,6 +31,8 @@
 #include "convert.h"
 #include "strings.h"
 #include "compress.h"
+#include "thread.h"
+#include "cache.h"
 #include "log.h"
 
 #include <string.h>
@@ -52,6 +54,7 @@ convert_t *convert_alloc(void)
     convert->images = NULL;
     convert->numImages = 0;
     convert->compress = COMPRESS_NONE;
+    convert->compressLevel = COMPRESS_LEVEL_OPTIMAL;
     convert->palette = NULL;
     convert->tilesetGroups = NULL;
     convert->numTilesetGroups = 0;
@@ -60,6 +63,10 @@ convert_t *convert_alloc(void)
     convert->widthAndHeight = true;
     convert->transparentIndex = -1;
     convert->bpp = BPP_8;
+    convert->remap = REMAP_LIQ;
+    convert->dither = true;
+    convert->groupSize = 0;
+    convert->groupCompress = COMPRESS_NONE;
     convert->name = NULL;
     convert->paletteName = strdup("xlibc");
 
@@ -94,6 +101,8 @@ static int convert_add_image(convert_t *convert, const char *path)
     image->height = 0;
     image->rlet = false;
     image->compressed = false;
+    image->compress = COMPRESS_NONE;
+    image->compressAuto = false;
 
     convert->numImages++;
 
@@ -158,8 +167,14 @@ static int convert_add_tileset(convert_t *convert, const char *path)
     tileset->tileHeight = tilesetGroup->tileHeight;
     tileset->tileWidth = tilesetGroup->tileWidth;
     tileset->pTable = tilesetGroup->pTable;
+    tileset->dedupe = tilesetGroup->dedupe;
     tileset->tiles = NULL;
     tileset->numTiles = 0;
+    tileset->tileMap = NULL;
+    tileset->tileFlags = NULL;
+    tileset->slab = NULL;
+    tileset->numUniqueTiles = 0;
+    tileset->compressAuto = false;
 
     image = &tileset->image;
     image->path = strdup(path);
@@ -168,6 +183,8 @@ static int convert_add_tileset(convert_t *convert, const char *path)
     image->width = 0;
     image->height = 0;
     image->compressed = false;
+    image->compress = COMPRESS_NONE;
+    image->compressAuto = false;
     image->rlet = false;
 
     tilesetGroup->numTilesets++;
@@ -311,60 +328,172 @@ int convert_find_palette(convert_t *convert, palette_t **palettes, int numPalett
     return 1;
 }
 
+/*
+ * Gets the image transforms selected by the convert flags.
+ */
+static image_transform_t convert_image_transform(convert_t *convert)
+{
+    image_transform_t transform =
+    {
+        .rlet = convert->style == CONVERT_STYLE_RLET,
+        .transparentIndex = convert->transparentIndex,
+        .omitIndices = convert->omitIndices,
+        .numOmitIndices = convert->numOmitIndices,
+        .bpp = convert->bpp,
+        .paletteNumEntries = convert->palette->numEntries,
+        .widthAndHeight = convert->widthAndHeight,
+    };
+
+    return transform;
+}
+
 /*
  * Converts an image using flags.
  */
 static int convert_image(convert_t *convert, image_t *image)
 {
+    image_transform_t transform = convert_image_transform(convert);
     int ret;
 
-    if (convert->style == CONVERT_STYLE_RLET)
+    ret = image_transform(image, &transform);
+    if (ret != 0)
     {
-        ret = image_rlet(image, convert->transparentIndex);
-        if (ret != 0)
-        {
-            return ret;
-        }
+        return ret;
+    }
+
+    image->rlet = transform.rlet;
+
+    return 0;
+}
 
-        image->rlet = true;
+/*
+ * Compresses a converted image if needed.
+ */
+static int convert_compress_image(convert_t *convert, image_t *image)
+{
+    if (convert->compress != COMPRESS_NONE)
+    {
+        return image_compress(image, convert->compress, convert->compressLevel);
     }
 
-    if (convert->numOmitIndices != 0)
+    return 0;
+}
+
+typedef struct
+{
+    tileset_t *tileset;
+    image_t *compressed;
+    compress_t compress;
+    compress_level_t level;
+} convert_tileset_job_t;
+
+/*
+ * Compresses a copy of a single converted tile, used as a thread job.
+ */
+static int convert_compress_tile(void *arg, int index)
+{
+    convert_tileset_job_t *job = arg;
+    tileset_tile_t *tile = &job->tileset->tiles[index];
+    image_t *image = &job->compressed[index];
+
+    image->data = malloc(tile->size + 1);
+    if (image->data == NULL)
     {
-        ret = image_remove_omits(image, convert->omitIndices, convert->numOmitIndices);
-        if (ret != 0)
-        {
-            return ret;
-        }
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    memcpy(image->data, tile->data, tile->size);
+    image->size = tile->size;
+
+    return image_compress(image, job->compress, job->level);
+}
+
+/*
+ * Compresses every stored tile and moves the results into a new slab.
+ */
+int convert_compress_tileset(tileset_t *tileset, compress_t compress, compress_level_t level)
+{
+    convert_tileset_job_t job = { tileset, NULL, compress, level };
+    uint8_t *slab = NULL;
+    size_t total = 0;
+    int ret;
+    int i;
+
+    job.compressed = calloc(tileset->numUniqueTiles + 1, sizeof(image_t));
+    if (job.compressed == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
     }
 
-    if (convert->bpp != BPP_8)
+    /* tiles are independent, so compress them all at once */
+    ret = thread_run(convert_compress_tile, &job, tileset->numUniqueTiles);
+    if (ret == 0)
     {
-        ret = image_set_bpp(image, convert->bpp, convert->palette->numEntries);
-        if (ret != 0)
+        for (i = 0; i < tileset->numUniqueTiles; ++i)
         {
-            return ret;
+            total += job.compressed[i].size;
+        }
+
+        slab = malloc(total + 1);
+        if (slab == NULL)
+        {
+            LL_DEBUG("Memory error in %s", __func__);
+            ret = 1;
         }
     }
 
-    if (convert->widthAndHeight == true)
+    if (ret == 0)
     {
-        ret = image_add_width_and_height(image);
-        if (ret != 0)
+        total = 0;
+        for (i = 0; i < tileset->numUniqueTiles; ++i)
         {
-            return ret;
+            memcpy(slab + total, job.compressed[i].data, job.compressed[i].size);
+            total += job.compressed[i].size;
+            tileset->tiles[i].size = job.compressed[i].size;
+            tileset->tiles[i].compress = job.compressed[i].compress;
+            if (job.compressed[i].compressed)
+            {
+                tileset->compressed = true;
+            }
         }
+
+        tileset_set_slab(tileset, slab);
     }
 
-    if (convert->compress != COMPRESS_NONE)
+    for (i = 0; i < tileset->numUniqueTiles; ++i)
     {
-        ret = image_compress(image, convert->compress);
-        if (ret != 0)
+        free(job.compressed[i].data);
+    }
+
+    free(job.compressed);
+
+    return ret;
+}
+
+/*
+ * Copies one row of tiles out of the tileset image, used as a thread job.
+ */
+static int convert_extract_tile_row(void *arg, int index)
+{
+    tileset_t *tileset = arg;
+    int tilesPerRow = tileset->image.width / tileset->tileWidth;
+    const uint8_t *src = tileset->image.data +
+        (size_t)index * tileset->tileHeight * tileset->image.width;
+    int i, j;
+
+    for (i = 0; i < tilesPerRow; ++i)
+    {
+        uint8_t *dst = tileset->tiles[index * tilesPerRow + i].data;
+        const uint8_t *row = src + i * tileset->tileWidth;
+
+        for (j = 0; j < tileset->tileHeight; ++j)
         {
-            return ret;
+            memcpy(dst, row, tileset->tileWidth);
+            dst += tileset->tileWidth;
+            row += tileset->image.width;
         }
-
-        image->compressed = true;
     }
 
     return 0;
@@ -375,9 +504,13 @@ static int convert_image(convert_t *convert, image_t *image)
  */
 int convert_tileset(convert_t *convert, tileset_t *tileset)
 {
+    image_transform_t transform = convert_image_transform(convert);
+    image_t shape;
+    uint8_t *slab;
+    size_t offset = 0;
+    int bound;
     int ret = 0;
-    int i, j, k;
-    int x, y;
+    int i;
 
     tileset->numTiles =
         (tileset->image.width / tileset->tileWidth) *
@@ -394,13 +527,52 @@ int convert_tileset(convert_t *convert, tileset_t *tileset)
         return 1;
     }
 
-    tileset->compressed = convert->compress != COMPRESS_NONE;
+    tileset->compressed = false;
 
-    tileset_alloc_tiles(tileset);
+    ret = tileset_alloc_tiles(tileset);
+    if (ret != 0)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return ret;
+    }
 
-    y = x = 0;
+    ret = thread_run(convert_extract_tile_row,
+                     tileset,
+                     tileset->image.height / tileset->tileHeight);
+    if (ret != 0)
+    {
+        return ret;
+    }
 
-    for (i = 0; i < tileset->numTiles; ++i)
+    /* identical source tiles convert identically, so drop them first */
+    if (tileset->dedupe != TILESET_DEDUPE_NONE)
+    {
+        ret = tileset_dedupe(tileset);
+        if (ret != 0)
+        {
+            return ret;
+        }
+
+        LL_DEBUG("Tileset \'%s\': %d of %d tiles unique",
+            tileset->image.name,
+            tileset->numUniqueTiles,
+            tileset->numTiles);
+    }
+
+    /* convert the stored tiles back to back into a new slab */
+    shape.width = tileset->tileWidth;
+    shape.height = tileset->tileHeight;
+    shape.size = shape.width * shape.height;
+    bound = image_transform_bound(&shape, &transform);
+
+    slab = malloc((size_t)bound * tileset->numUniqueTiles + 1);
+    if (slab == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    for (i = 0; i < tileset->numUniqueTiles; ++i)
     {
         image_t tile =
         {
@@ -411,147 +583,498 @@ int convert_tileset(convert_t *convert, tileset_t *tileset)
             .name = NULL,
             .path = NULL
         };
-        int byte = 0;
 
+        ret = image_transform_to(&tile, &transform, slab + offset);
         if (ret != 0)
         {
-            break;
+            free(slab);
+            return ret;
         }
 
-        for (j = 0; j < tile.height; ++j)
+        tileset->tiles[i].size = tile.size;
+        offset += tile.size;
+    }
+
+    tileset_set_slab(tileset, slab);
+
+    if (convert->compress != COMPRESS_NONE)
+    {
+        ret = convert_compress_tileset(tileset, convert->compress, convert->compressLevel);
+    }
+
+    return ret;
+}
+
+/*
+ * Builds the cache key of an image or tileset from the source file,
+ * palette, and convert options.
+ */
+static int convert_cache_key(convert_t *convert,
+                             const char *type,
+                             image_t *image,
+                             tileset_t *tileset,
+                             cache_key_t *key)
+{
+    palette_t *palette = convert->palette;
+    int i;
+
+    cache_key_init(key, type);
+
+    if (cache_key_add_file(key, image->path) != 0)
+    {
+        return 1;
+    }
+
+    cache_key_add_int(key, palette->mode);
+    cache_key_add_int(key, palette->numEntries);
+    for (i = 0; i < palette->numEntries; ++i)
+    {
+        color_t *color = &palette->entries[i].color;
+
+        cache_key_add(key, &color->rgb, sizeof(liq_color));
+        cache_key_add_int(key, color->target);
+    }
+
+    cache_key_add_int(key, convert->style);
+    cache_key_add_int(key, convert->compress);
+    cache_key_add_int(key, convert->compressLevel);
+    cache_key_add_int(key, convert->transparentIndex);
+    cache_key_add_int(key, convert->widthAndHeight);
+    cache_key_add_int(key, convert->bpp);
+    cache_key_add_int(key, convert->remap);
+    cache_key_add_int(key, convert->dither);
+    cache_key_add_int(key, convert->numOmitIndices);
+    for (i = 0; i < convert->numOmitIndices; ++i)
+    {
+        cache_key_add_int(key, convert->omitIndices[i]);
+    }
+
+    if (tileset != NULL)
+    {
+        cache_key_add_int(key, tileset->tileWidth);
+        cache_key_add_int(key, tileset->tileHeight);
+        cache_key_add_int(key, tileset->dedupe);
+    }
+
+    return 0;
+}
+
+/*
+ * Restores a converted image from the cache.
+ */
+static int convert_cache_load_image(const cache_key_t *key, image_t *image)
+{
+    cache_blob_t blob;
+    int rlet, compress;
+    int ret = 1;
+
+    if (cache_load(key, "img", &blob) != 0)
+    {
+        return 1;
+    }
+
+    if (cache_blob_read_int(&blob, &image->width) == 0 &&
+        cache_blob_read_int(&blob, &image->height) == 0 &&
+        cache_blob_read_int(&blob, &image->size) == 0 &&
+        cache_blob_read_int(&blob, &rlet) == 0 &&
+        cache_blob_read_int(&blob, &compress) == 0 &&
+        compress >= COMPRESS_NONE && compress < COMPRESS_AUTO &&
+        image->size >= 0)
+    {
+        image->data = malloc(image->size + 1);
+        if (image->data != NULL &&
+            cache_blob_read(&blob, image->data, image->size) == 0)
         {
-            int offset = j * tileset->image.width + y;
-            for (k = 0; k < tile.width; ++k)
-            {
-                tile.data[byte] = tileset->image.data[k + x + offset];
-                byte++;
-            }
+            image->rlet = rlet;
+            image->compress = compress;
+            image->compressed = compress != COMPRESS_NONE;
+            ret = 0;
         }
+        else
+        {
+            free(image->data);
+            image->data = NULL;
+        }
+    }
 
-        ret = convert_image(convert, &tile);
-        if (ret != 0)
+    cache_blob_free(&blob);
+
+    return ret;
+}
+
+/*
+ * Stores a converted image in the cache.
+ */
+static void convert_cache_store_image(const cache_key_t *key, image_t *image)
+{
+    cache_blob_t blob = { NULL, 0, 0 };
+
+    if (cache_blob_write_int(&blob, image->width) == 0 &&
+        cache_blob_write_int(&blob, image->height) == 0 &&
+        cache_blob_write_int(&blob, image->size) == 0 &&
+        cache_blob_write_int(&blob, image->rlet) == 0 &&
+        cache_blob_write_int(&blob, image->compress) == 0 &&
+        cache_blob_write(&blob, image->data, image->size) == 0)
+    {
+        cache_store(key, "img", &blob);
+    }
+
+    cache_blob_free(&blob);
+}
+
+/*
+ * Restores converted tiles from the cache.
+ */
+static int convert_cache_load_tileset(const cache_key_t *key, tileset_t *tileset)
+{
+    cache_blob_t blob;
+    int compressed;
+    int numTiles, numUniqueTiles;
+    int i;
+
+    if (cache_load(key, "tls", &blob) != 0)
+    {
+        return 1;
+    }
+
+    if (cache_blob_read_int(&blob, &tileset->image.width) != 0 ||
+        cache_blob_read_int(&blob, &tileset->image.height) != 0 ||
+        cache_blob_read_int(&blob, &compressed) != 0 ||
+        cache_blob_read_int(&blob, &numTiles) != 0 ||
+        cache_blob_read_int(&blob, &numUniqueTiles) != 0 ||
+        numUniqueTiles < 0 || numUniqueTiles > numTiles)
+    {
+        goto error;
+    }
+
+    tileset->tiles = calloc(numTiles + 1, sizeof(tileset_tile_t));
+    tileset->tileMap = calloc(numTiles + 1, sizeof(int));
+    tileset->tileFlags = calloc(numTiles + 1, sizeof(uint8_t));
+    if (tileset->tiles == NULL ||
+        tileset->tileMap == NULL ||
+        tileset->tileFlags == NULL)
+    {
+        goto error;
+    }
+
+    tileset->numTiles = numTiles;
+    tileset->numUniqueTiles = numUniqueTiles;
+    tileset->compressed = compressed;
+
+    for (i = 0; i < numTiles; ++i)
+    {
+        int *entry = &tileset->tileMap[i];
+        int flags;
+
+        if (cache_blob_read_int(&blob, entry) != 0 ||
+            cache_blob_read_int(&blob, &flags) != 0 ||
+            *entry < 0 || *entry >= numUniqueTiles)
         {
-            break;
+            goto error;
         }
 
-        tileset->tiles[i].size = tile.size;
-        tileset->tiles[i].data = tile.data;
+        tileset->tileFlags[i] = flags;
+    }
+
+    /* the remaining blob bounds the size of all tile data */
+    tileset->slab = malloc(blob.size - blob.offset + 1);
+    if (tileset->slab == NULL)
+    {
+        goto error;
+    }
+
+    for (i = 0; i < numUniqueTiles; ++i)
+    {
+        tileset_tile_t *tile = &tileset->tiles[i];
+
+        int compress;
 
-        x += tileset->tileWidth;
+        tile->data = i == 0 ? tileset->slab :
+            tileset->tiles[i - 1].data + tileset->tiles[i - 1].size;
 
-        if (x >= tileset->image.width)
+        if (cache_blob_read_int(&blob, &compress) != 0 ||
+            compress < COMPRESS_NONE || compress >= COMPRESS_AUTO ||
+            cache_blob_read_int(&blob, &tile->size) != 0 ||
+            tile->size < 0 ||
+            cache_blob_read(&blob, tile->data, tile->size) != 0)
         {
-            x = 0;
-            y += tileset->image.width * tileset->tileHeight;
+            goto error;
         }
+
+        tile->compress = compress;
+    }
+
+    cache_blob_free(&blob);
+
+    return 0;
+
+error:
+    free(tileset->slab);
+    tileset->slab = NULL;
+    free(tileset->tiles);
+    tileset->tiles = NULL;
+    free(tileset->tileMap);
+    tileset->tileMap = NULL;
+    free(tileset->tileFlags);
+    tileset->tileFlags = NULL;
+    tileset->numTiles = 0;
+    tileset->numUniqueTiles = 0;
+    cache_blob_free(&blob);
+
+    return 1;
+}
+
+/*
+ * Stores converted tiles in the cache.
+ */
+static void convert_cache_store_tileset(const cache_key_t *key, tileset_t *tileset)
+{
+    cache_blob_t blob = { NULL, 0, 0 };
+    int ret;
+    int i;
+
+    ret = cache_blob_write_int(&blob, tileset->image.width);
+    ret |= cache_blob_write_int(&blob, tileset->image.height);
+    ret |= cache_blob_write_int(&blob, tileset->compressed);
+    ret |= cache_blob_write_int(&blob, tileset->numTiles);
+    ret |= cache_blob_write_int(&blob, tileset->numUniqueTiles);
+
+    for (i = 0; i < tileset->numTiles && ret == 0; ++i)
+    {
+        ret |= cache_blob_write_int(&blob, tileset->tileMap[i]);
+        ret |= cache_blob_write_int(&blob, tileset->tileFlags[i]);
+    }
+
+    for (i = 0; i < tileset->numUniqueTiles && ret == 0; ++i)
+    {
+        ret |= cache_blob_write_int(&blob, tileset->tiles[i].compress);
+        ret |= cache_blob_write_int(&blob, tileset->tiles[i].size);
+        ret |= cache_blob_write(&blob, tileset->tiles[i].data, tileset->tiles[i].size);
+    }
+
+    if (ret == 0)
+    {
+        cache_store(key, "tls", &blob);
+    }
+
+    cache_blob_free(&blob);
+}
+
+/*
+ * Loads, quantizes, and converts a single image, used as a thread job.
+ */
+static int convert_convert_image(void *arg, int index)
+{
+    convert_t *convert = arg;
+    image_t *image = &convert->images[index];
+    cache_key_t key;
+    bool cached;
+    int ret;
+
+    LL_INFO(" - Reading image \'%s\'",
+        image->path);
+
+    image->compressAuto = convert->compress == COMPRESS_AUTO;
+
+    cached = cache_enabled() &&
+        convert_cache_key(convert, "image", image, NULL, &key) == 0;
+    if (cached && convert_cache_load_image(&key, image) == 0)
+    {
+        image_cache_skip(image->path);
+        return 0;
+    }
+
+    ret = image_load(image);
+    if (ret != 0)
+    {
+        LL_ERROR("Failed to load image \'%s\'", image->path);
+        return ret;
+    }
+
+    ret = remap_image(image, convert->palette, convert->remap, convert->dither);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    ret = convert_image(convert, image);
+    if (ret == 0)
+    {
+        ret = convert_compress_image(convert, image);
+    }
+
+    if (ret == 0 && cached)
+    {
+        convert_cache_store_image(&key, image);
     }
 
     return ret;
 }
 
+typedef struct
+{
+    convert_t *convert;
+    tileset_t **tilesets;
+} convert_tilesets_job_t;
+
 /*
- * Converts an image to a palette or raw data as needed.
+ * Loads, quantizes, and converts a single tileset, used as a thread job.
  */
-int convert_convert(convert_t *convert, palette_t **palettes, int numPalettes)
+static int convert_convert_tileset(void *arg, int index)
 {
-    int i, j;
-    int ret = 0;
+    convert_tilesets_job_t *job = arg;
+    convert_t *convert = job->convert;
+    tileset_t *tileset = job->tilesets[index];
+    image_t *image = &tileset->image;
+    cache_key_t key;
+    bool cached;
+    int ret;
 
-    if (convert == NULL)
+    LL_INFO(" - Reading tileset \'%s\'",
+        image->path);
+
+    tileset->compressAuto = convert->compress == COMPRESS_AUTO;
+
+    cached = cache_enabled() &&
+        convert_cache_key(convert, "tileset", image, tileset, &key) == 0;
+    if (cached && convert_cache_load_tileset(&key, tileset) == 0)
     {
-        return 1;
+        image_cache_skip(image->path);
+        return 0;
     }
 
-    if (convert->numImages > 0)
+    ret = image_load(image);
+    if (ret != 0)
     {
-        LL_INFO("Converting images for \'%s\'", convert->name);
+        LL_ERROR("Failed to load image \'%s\'", image->path);
+        return ret;
     }
 
-    ret = convert_find_palette(convert, palettes, numPalettes);
+    ret = remap_image(image, convert->palette, convert->remap, convert->dither);
     if (ret != 0)
     {
         return ret;
     }
 
-    for (i = 0; i < convert->numImages; ++i)
+    ret = convert_tileset(convert, tileset);
+    if (ret != 0)
     {
-        image_t *image = &convert->images[i];
+        return ret;
+    }
 
-        if (ret != 0)
-        {
-            break;
-        }
+    if (cached)
+    {
+        convert_cache_store_tileset(&key, tileset);
+    }
 
-        LL_INFO(" - Reading image \'%s\'",
-            image->path);
+    return 0;
+}
 
-        ret = image_load(image);
-        if (ret != 0)
-        {
-            LL_ERROR("Failed to load image \'%s\'", image->path);
-            break;
-        }
+/*
+ * Converts every tileset of every group at once.
+ */
+static int convert_convert_tilesets(convert_t *convert)
+{
+    convert_tilesets_job_t job = { convert, NULL };
+    int numTilesets = 0;
+    int ret;
+    int i, j;
 
-        ret = image_quantize(image, convert->palette);
-        if (ret != 0)
-        {
-            break;
-        }
+    for (i = 0; i < convert->numTilesetGroups; ++i)
+    {
+        numTilesets += convert->tilesetGroups[i]->numTilesets;
+    }
 
-        ret = convert_image(convert, image);
-        if (ret != 0)
+    job.tilesets = malloc((numTilesets + 1) * sizeof(tileset_t *));
+    if (job.tilesets == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    numTilesets = 0;
+    for (i = 0; i < convert->numTilesetGroups; ++i)
+    {
+        tileset_group_t *tilesetGroup = convert->tilesetGroups[i];
+
+        for (j = 0; j < tilesetGroup->numTilesets; ++j)
         {
-            break;
+            job.tilesets[numTilesets++] = &tilesetGroup->tilesets[j];
         }
     }
 
-    if (convert->numTilesetGroups > 0)
+    ret = thread_run(convert_convert_tileset, &job, numTilesets);
+
+    free(job.tilesets);
+
+    return ret;
+}
+
+/*
+ * Registers the image loads conversion will make with the decoded
+ * image cache, before any palette is generated.
+ */
+void convert_expect_images(const convert_t *convert)
+{
+    int i, j;
+
+    for (i = 0; i < convert->numImages; ++i)
     {
-        LL_INFO("Converting tilesets for \'%s\'", convert->name);
+        image_cache_expect(convert->images[i].path);
     }
 
     for (i = 0; i < convert->numTilesetGroups; ++i)
     {
         tileset_group_t *tilesetGroup = convert->tilesetGroups[i];
 
-        if (ret != 0)
+        for (j = 0; j < tilesetGroup->numTilesets; ++j)
         {
-            break;
+            image_cache_expect(tilesetGroup->tilesets[j].image.path);
         }
+    }
+}
 
-        for (j = 0; j < tilesetGroup->numTilesets; ++j)
-        {
-            tileset_t *tileset = &tilesetGroup->tilesets[i];
-            image_t *image = &tileset->image;
+/*
+ * Converts an image to a palette or raw data as needed.
+ */
+int convert_convert(convert_t *convert, palette_t **palettes, int numPalettes)
+{
+    int ret = 0;
 
-            if (ret != 0)
-            {
-                break;
-            }
+    if (convert == NULL)
+    {
+        return 1;
+    }
 
-            LL_INFO(" - Reading tileset \'%s\'",
-                image->path);
+    if (convert->numImages > 0)
+    {
+        LL_INFO("Converting images for \'%s\'", convert->name);
+    }
 
-            ret = image_load(image);
-            if (ret != 0)
-            {
-                LL_ERROR("Failed to load image \'%s\'", image->path);
-                break;
-            }
+    ret = convert_find_palette(convert, palettes, numPalettes);
+    if (ret != 0)
+    {
+        return ret;
+    }
 
-            ret = image_quantize(image, convert->palette);
-            if (ret != 0)
-            {
-                break;
-            }
+    ret = remap_build(convert->palette, convert->remap, thread_get_count());
+    if (ret != 0)
+    {
+        return ret;
+    }
 
-            ret = convert_tileset(convert, tileset);
-            if (ret != 0)
-            {
-                break;
-            }
-        }
+    ret = thread_run(convert_convert_image, convert, convert->numImages);
+    if (ret != 0)
+    {
+        return ret;
     }
 
+    if (convert->numTilesetGroups > 0)
+    {
+        LL_INFO("Converting tilesets for \'%s\'", convert->name);
+    }
+
+    ret = convert_convert_tilesets(convert);
+
     return ret;
 }
@@ -39,6 +39,7 @@ extern "C" {
 #include "palette.h"
 #include "tileset.h"
 #include "compress.h"
+#include "remap.h"
 
 typedef enum
 {
@@ -55,6 +56,7 @@ typedef struct convert
     tileset_group_t **tilesetGroups;
     int numTilesetGroups;
     compress_t compress;
+    compress_level_t compressLevel;
     palette_t *palette;
     convert_style_t style;
     int omitIndices[PALETTE_MAX_ENTRIES];
@@ -62,6 +64,12 @@ typedef struct convert
     int transparentIndex;
     bool widthAndHeight;
     bpp_t bpp;
+    remap_t remap;
+    bool dither;
+
+    /* set by output */
+    int groupSize;
+    compress_t groupCompress;
 } convert_t;
 
 convert_t *convert_alloc(void);
@@ -69,7 +77,9 @@ void convert_free(convert_t *convert);
 int convert_alloc_tileset_group(convert_t *convert);
 int convert_add_image_path(convert_t *convert, const char *path);
 int convert_add_tileset_path(convert_t *convert, const char *path);
+void convert_expect_images(const convert_t *convert);
 int convert_convert(convert_t *convert, palette_t **palettes, int numPalettes);
+int convert_compress_tileset(tileset_t *tileset, compress_t compress, compress_level_t level);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,156 @@
+/*
+ * (c) Copyright 2021 by Einar Saukas. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of its author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+
+#include "zx0.h"
+
+static void write_byte(zx0_t *ctx, int value) {
+    ctx->output_data[ctx->output_index++] = value;
+}
+
+static void write_bit(zx0_t *ctx, int value) {
+    if (ctx->backtrack) {
+        if (value) {
+            ctx->output_data[ctx->output_index-1] |= 1;
+        }
+        ctx->backtrack = 0;
+    } else {
+        if (!ctx->bit_mask) {
+            ctx->bit_mask = 128;
+            ctx->bit_index = ctx->output_index;
+            write_byte(ctx, 0);
+        }
+        if (value) {
+            ctx->output_data[ctx->bit_index] |= ctx->bit_mask;
+        }
+        ctx->bit_mask >>= 1;
+    }
+}
+
+static void write_interlaced_elias_gamma(zx0_t *ctx, int value, int invert_mode) {
+    int i;
+
+    for (i = 2; i <= value; i <<= 1)
+        ;
+    i >>= 1;
+    while (i >>= 1) {
+        write_bit(ctx, 0);
+        write_bit(ctx, invert_mode ? !(value & i) : (value & i));
+    }
+    write_bit(ctx, 1);
+}
+
+unsigned char *zx0_compress(zx0_t *ctx, BLOCK *optimal, unsigned char *input_data, int input_size, int *output_size) {
+    BLOCK *prev;
+    BLOCK *next;
+    int input_index;
+    int last_offset;
+    int after_literals;
+    int length;
+    int i;
+
+    if (!optimal || input_size <= 0) {
+        return NULL;
+    }
+
+    /* calculate and allocate output buffer */
+    *output_size = (optimal->bits+25)/8;
+    ctx->output_data = (unsigned char *)malloc(*output_size);
+    if (!ctx->output_data) {
+        return NULL;
+    }
+
+    /* un-reverse optimal sequence */
+    prev = NULL;
+    while (optimal) {
+        next = optimal->chain;
+        optimal->chain = prev;
+        prev = optimal;
+        optimal = next;
+    }
+
+    /* initialize data */
+    input_index = 0;
+    last_offset = INITIAL_OFFSET;
+    after_literals = 0;
+    ctx->output_index = 0;
+    ctx->bit_mask = 0;
+
+    /* the first literals indicator is implicit */
+    ctx->backtrack = 1;
+
+    /* generate output */
+    for (optimal = prev->chain; optimal; prev = optimal, optimal = optimal->chain) {
+        length = optimal->index-prev->index;
+
+        if (!optimal->offset) {
+            /* copy literals indicator */
+            write_bit(ctx, 0);
+
+            /* copy literals length */
+            write_interlaced_elias_gamma(ctx, length, 0);
+
+            /* copy literals values */
+            for (i = 0; i < length; i++) {
+                write_byte(ctx, input_data[input_index++]);
+            }
+            after_literals = 1;
+        } else if (optimal->offset == last_offset && after_literals) {
+            /* copy from last offset indicator */
+            write_bit(ctx, 0);
+
+            /* copy from last offset length */
+            write_interlaced_elias_gamma(ctx, length, 0);
+            input_index += length;
+            after_literals = 0;
+        } else {
+            /* copy from new offset indicator */
+            write_bit(ctx, 1);
+
+            /* copy from new offset MSB */
+            write_interlaced_elias_gamma(ctx, (optimal->offset-1)/128+1, 1);
+
+            /* copy from new offset LSB, its low bit is the first length bit */
+            write_byte(ctx, (127-(optimal->offset-1)%128)<<1);
+
+            /* copy from new offset length */
+            ctx->backtrack = 1;
+            write_interlaced_elias_gamma(ctx, length-1, 0);
+            input_index += length;
+            last_offset = optimal->offset;
+            after_literals = 0;
+        }
+    }
+
+    /* end marker */
+    write_bit(ctx, 1);
+    write_interlaced_elias_gamma(ctx, 256, 1);
+
+    /* the size estimate can be a byte over */
+    *output_size = ctx->output_index;
+
+    return ctx->output_data;
+}
@@ -0,0 +1,279 @@
+/*
+ * (c) Copyright 2021 by Einar Saukas. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of its author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "zx0.h"
+
+#define QTY_BLOCKS 10000
+
+static BLOCK *allocate(zx0_t *ctx, int bits, int index, int offset, BLOCK *chain) {
+    BLOCK *ptr;
+
+    if (ctx->ghost_root) {
+        ptr = ctx->ghost_root;
+        ctx->ghost_root = ptr->ghost_chain;
+        if (ptr->chain && !--ptr->chain->references) {
+            ptr->chain->ghost_chain = ctx->ghost_root;
+            ctx->ghost_root = ptr->chain;
+        }
+    } else {
+        if (!ctx->dead_array_size) {
+            if (ctx->used_arrays == ctx->num_arrays) {
+                BLOCK **arrays;
+                BLOCK *array;
+
+                arrays = (BLOCK **)realloc(ctx->arrays, (ctx->num_arrays+1) * sizeof(BLOCK *));
+                if (!arrays) {
+                    return NULL;
+                }
+                ctx->arrays = arrays;
+                array = (BLOCK *)malloc(QTY_BLOCKS * sizeof(BLOCK));
+                if (!array) {
+                    return NULL;
+                }
+                ctx->arrays[ctx->num_arrays++] = array;
+            }
+            ctx->dead_array = ctx->arrays[ctx->used_arrays++];
+            ctx->dead_array_size = QTY_BLOCKS;
+        }
+        ptr = &ctx->dead_array[--ctx->dead_array_size];
+    }
+    ptr->bits = bits;
+    ptr->index = index;
+    ptr->offset = offset;
+    if (chain) {
+        chain->references++;
+    }
+    ptr->chain = chain;
+    ptr->references = 0;
+    return ptr;
+}
+
+static void assign(zx0_t *ctx, BLOCK **ptr, BLOCK *chain) {
+    chain->references++;
+    if (*ptr && !--(*ptr)->references) {
+        (*ptr)->ghost_chain = ctx->ghost_root;
+        ctx->ghost_root = *ptr;
+    }
+    *ptr = chain;
+}
+
+/* grows the parser scratch, the previous contents are not kept */
+static int allocate_scratch(zx0_t *ctx, int input_size, int offset_size) {
+    if (ctx->offset_size < offset_size) {
+        free(ctx->last_literal);
+        free(ctx->last_match);
+        free(ctx->match_length);
+        ctx->last_literal = (BLOCK **)malloc(offset_size * sizeof(BLOCK *));
+        ctx->last_match = (BLOCK **)malloc(offset_size * sizeof(BLOCK *));
+        ctx->match_length = (int *)malloc(offset_size * sizeof(int));
+        ctx->offset_size = offset_size;
+        if (!ctx->last_literal || !ctx->last_match || !ctx->match_length) {
+            ctx->offset_size = 0;
+            return 0;
+        }
+    }
+    if (ctx->input_size < input_size) {
+        free(ctx->optimal);
+        free(ctx->best_length);
+        ctx->optimal = (BLOCK **)malloc(input_size * sizeof(BLOCK *));
+        ctx->best_length = (int *)malloc(input_size * sizeof(int));
+        ctx->input_size = input_size;
+        if (!ctx->optimal || !ctx->best_length) {
+            ctx->input_size = 0;
+            return 0;
+        }
+    }
+    memset(ctx->last_literal, 0, offset_size * sizeof(BLOCK *));
+    memset(ctx->last_match, 0, offset_size * sizeof(BLOCK *));
+    memset(ctx->match_length, 0, offset_size * sizeof(int));
+    memset(ctx->optimal, 0, input_size * sizeof(BLOCK *));
+    return 1;
+}
+
+static int offset_ceiling(int index, int offset_limit) {
+    return index > offset_limit ? offset_limit : index < INITIAL_OFFSET ? INITIAL_OFFSET : index;
+}
+
+static int elias_gamma_bits(int value) {
+    int bits;
+
+    bits = 1;
+    while (value >>= 1) {
+        bits += 2;
+    }
+    return bits;
+}
+
+BLOCK *zx0_optimize(zx0_t *ctx, unsigned char *input_data, int input_size, int offset_limit) {
+    BLOCK **last_literal;
+    BLOCK **last_match;
+    BLOCK **optimal;
+    BLOCK *block;
+    BLOCK *result;
+    int *match_length;
+    int *best_length;
+    int best_length_size;
+    int bits;
+    int index;
+    int offset;
+    int length;
+    int bits2;
+    int max_offset;
+
+    if (input_size <= 0) {
+        return NULL;
+    }
+
+    max_offset = offset_ceiling(input_size-1, offset_limit);
+
+    /* blocks of a previous call are recycled from the start */
+    ctx->ghost_root = NULL;
+    ctx->dead_array = NULL;
+    ctx->dead_array_size = 0;
+    ctx->used_arrays = 0;
+
+    if (!allocate_scratch(ctx, input_size, max_offset+1)) {
+        return NULL;
+    }
+    last_literal = ctx->last_literal;
+    last_match = ctx->last_match;
+    match_length = ctx->match_length;
+    optimal = ctx->optimal;
+    best_length = ctx->best_length;
+    result = NULL;
+
+    if (input_size > 2) {
+        best_length[2] = 2;
+    }
+
+    /* start with fake block */
+    block = allocate(ctx, -1, -1, INITIAL_OFFSET, NULL);
+    if (!block) {
+        goto done;
+    }
+    assign(ctx, &last_match[INITIAL_OFFSET], block);
+
+    /* process remaining bytes */
+    for (index = 0; index < input_size; index++) {
+        best_length_size = 2;
+        max_offset = offset_ceiling(index, offset_limit);
+        for (offset = 1; offset <= max_offset; offset++) {
+            if (index != 0 && index >= offset && input_data[index] == input_data[index-offset]) {
+                /* copy from last offset */
+                if (last_literal[offset]) {
+                    length = index-last_literal[offset]->index;
+                    bits = last_literal[offset]->bits + 1 + elias_gamma_bits(length);
+                    block = allocate(ctx, bits, index, offset, last_literal[offset]);
+                    if (!block) {
+                        goto done;
+                    }
+                    assign(ctx, &last_match[offset], block);
+                    if (!optimal[index] || optimal[index]->bits > bits) {
+                        assign(ctx, &optimal[index], last_match[offset]);
+                    }
+                }
+                /* copy from new offset */
+                if (++match_length[offset] > 1) {
+                    if (best_length_size < match_length[offset]) {
+                        bits = optimal[index-best_length[best_length_size]]->bits + elias_gamma_bits(best_length[best_length_size]-1);
+                        do {
+                            best_length_size++;
+                            bits2 = optimal[index-best_length_size]->bits + elias_gamma_bits(best_length_size-1);
+                            if (bits2 <= bits) {
+                                best_length[best_length_size] = best_length_size;
+                                bits = bits2;
+                            } else {
+                                best_length[best_length_size] = best_length[best_length_size-1];
+                            }
+                        } while (best_length_size < match_length[offset]);
+                    }
+                    length = best_length[match_length[offset]];
+                    bits = optimal[index-length]->bits + 8 + elias_gamma_bits((offset-1)/128+1) + elias_gamma_bits(length-1);
+                    if (!last_match[offset] || last_match[offset]->index != index || last_match[offset]->bits > bits) {
+                        block = allocate(ctx, bits, index, offset, optimal[index-length]);
+                        if (!block) {
+                            goto done;
+                        }
+                        assign(ctx, &last_match[offset], block);
+                        if (!optimal[index] || optimal[index]->bits > bits) {
+                            assign(ctx, &optimal[index], last_match[offset]);
+                        }
+                    }
+                }
+            } else {
+                /* copy literals */
+                match_length[offset] = 0;
+                if (last_match[offset]) {
+                    length = index-last_match[offset]->index;
+                    bits = last_match[offset]->bits + 1 + elias_gamma_bits(length) + length*8;
+                    block = allocate(ctx, bits, index, 0, last_match[offset]);
+                    if (!block) {
+                        goto done;
+                    }
+                    assign(ctx, &last_literal[offset], block);
+                    if (!optimal[index] || optimal[index]->bits > bits) {
+                        assign(ctx, &optimal[index], last_literal[offset]);
+                    }
+                }
+            }
+        }
+    }
+
+    result = optimal[input_size-1];
+
+done:
+    return result;
+}
+
+void zx0_free(zx0_t *ctx) {
+    int i;
+
+    for (i = 0; i < ctx->num_arrays; i++) {
+        free(ctx->arrays[i]);
+    }
+    free(ctx->arrays);
+    ctx->arrays = NULL;
+    ctx->num_arrays = 0;
+    ctx->used_arrays = 0;
+    ctx->dead_array = NULL;
+    ctx->dead_array_size = 0;
+    ctx->ghost_root = NULL;
+
+    free(ctx->last_literal);
+    free(ctx->last_match);
+    free(ctx->match_length);
+    free(ctx->optimal);
+    free(ctx->best_length);
+    ctx->last_literal = NULL;
+    ctx->last_match = NULL;
+    ctx->match_length = NULL;
+    ctx->offset_size = 0;
+    ctx->optimal = NULL;
+    ctx->best_length = NULL;
+    ctx->input_size = 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * (c) Copyright 2021 by Einar Saukas. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of its author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+
+#define INITIAL_OFFSET      1
+#define MAX_OFFSET_ZX0  32640  /* range 1..32640 */
+#define MAX_OFFSET_ZX7   2176  /* quick mode, range 1..2176 */
+
+typedef struct block_t {
+    struct block_t *chain;
+    struct block_t *ghost_chain;
+    int bits;
+    int index;
+    int offset;
+    int references;
+} BLOCK;
+
+/* state for one compression at a time, several contexts can run at once */
+typedef struct zx0_t {
+    unsigned char *output_data;
+    size_t output_index;
+    size_t bit_index;
+    int bit_mask;
+    int backtrack;
+
+    /* blocks are recycled through the ghost list, arrays freed by zx0_free */
+    BLOCK *ghost_root;
+    BLOCK *dead_array;
+    int dead_array_size;
+    BLOCK **arrays;
+    int num_arrays;
+    int used_arrays;
+
+    /* parser scratch, kept between calls and grown as needed */
+    BLOCK **last_literal;
+    BLOCK **last_match;
+    int *match_length;
+    int offset_size;
+    BLOCK **optimal;
+    int *best_length;
+    int input_size;
+} zx0_t;
+
+/* both return NULL on error (empty input or out of memory), blocks stay
+   valid until the next zx0_optimize on the same context */
+BLOCK *zx0_optimize(zx0_t *ctx, unsigned char *input_data, int input_size, int offset_limit);
+
+unsigned char *zx0_compress(zx0_t *ctx, BLOCK *optimal, unsigned char *input_data, int input_size, int *output_size);
+
+void zx0_free(zx0_t *ctx);
@@ -23,12 +23,18 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <stdio.h>
 #include <stdlib.h>
 
 #include "zx7.h"
 
-int elias_gamma_bits(int value) {
+#define FAST_CHAIN     32  /* match candidates tried per position */
+#define FAST_NICE_LEN 256  /* stop searching at a match this long */
+#define FAST_LAZY_LEN  32  /* take a match this long without lookahead */
+
+static int elias_gamma_bits(int value) {
+#ifdef __GNUC__
+    return 1 + 2 * (31 - __builtin_clz((unsigned int)value));
+#else
     int bits;
 
     bits = 1;
@@ -37,85 +43,413 @@ int elias_gamma_bits(int value) {
         value >>= 1;
     }
     return bits;
+#endif
 }
 
-int count_bits(int offset, int len) {
+static int count_bits(int offset, int len) {
     return 1 + (offset > 128 ? 12 : 8) + elias_gamma_bits(len-1);
 }
 
-Optimal* optimize(unsigned char *input_data, size_t input_size) {
-    size_t *min;
-    size_t *max;
-    size_t *matches;
-    size_t *match_slots;
+/* hash of the 4 bytes ending at pos, for the long match chains */
+static int long_match_index(unsigned char *input_data, size_t pos) {
+    unsigned int quad;
+
+    quad = (unsigned int)input_data[pos-3] << 24 | input_data[pos-2] << 16 | input_data[pos-1] << 8 | input_data[pos];
+    return (quad * 2654435761u) >> 16;
+}
+
+static int allocate_scratch(zx7_t *ctx, size_t input_size) {
+    size_t tree_size;
+
+    if (!ctx->matches) {
+        ctx->min = (unsigned int *)calloc(MAX_OFFSET+1, sizeof(unsigned int));
+        ctx->max = (unsigned int *)calloc(MAX_OFFSET+1, sizeof(unsigned int));
+        ctx->matches = (unsigned int *)calloc(256*256, sizeof(unsigned int));
+        ctx->long_matches = (unsigned int *)calloc(256*256, sizeof(unsigned int));
+        if (!ctx->min || !ctx->max || !ctx->matches || !ctx->long_matches) {
+            zx7_free(ctx);
+            return 1;
+        }
+    }
+
+    if (ctx->match_slots_size < input_size) {
+        unsigned int *match_slots;
+
+        match_slots = (unsigned int *)realloc(ctx->match_slots, input_size * sizeof(unsigned int));
+        if (!match_slots) {
+            return 1;
+        }
+        ctx->match_slots = match_slots;
+        match_slots = (unsigned int *)realloc(ctx->long_match_slots, input_size * sizeof(unsigned int));
+        if (!match_slots) {
+            return 1;
+        }
+        ctx->long_match_slots = match_slots;
+        ctx->match_slots_size = input_size;
+    }
+
+    for (tree_size = 1; tree_size < input_size; tree_size <<= 1) {
+    }
+    if (ctx->tree_size < tree_size) {
+        unsigned int *tree;
+
+        tree = (unsigned int *)realloc(ctx->tree, 2 * tree_size * sizeof(unsigned int));
+        if (!tree) {
+            return 1;
+        }
+        ctx->tree = tree;
+        ctx->tree_size = tree_size;
+    }
+
+    return 0;
+}
+
+/* prefers fewer bits, then the later position (the shorter match) */
+#define TREE_BETTER(a, b) (optimal[a].bits < optimal[b].bits || \
+                           (optimal[a].bits == optimal[b].bits && (a) > (b)))
+
+/* records a final optimal[pos] in the tree, positions are added in order */
+static void tree_insert(zx7_t *ctx, Optimal *optimal, size_t pos) {
+    unsigned int *tree = ctx->tree;
+    size_t node = ctx->tree_size + pos;
+
+    tree[node] = pos;
+    for (; node > 1; node >>= 1) {
+        /* the right sibling only holds positions not added yet */
+        if (node & 1) {
+            tree[node >> 1] = TREE_BETTER(tree[node], tree[node ^ 1]) ? tree[node] : tree[node ^ 1];
+        } else {
+            tree[node >> 1] = tree[node];
+        }
+    }
+}
+
+/* best position in first..last, all of which were added */
+static size_t tree_query(zx7_t *ctx, Optimal *optimal, size_t first, size_t last) {
+    unsigned int *tree = ctx->tree;
+    size_t lo = ctx->tree_size + first;
+    size_t hi = ctx->tree_size + last + 1;
+    unsigned int best = first;
+
+    for (; lo < hi; lo >>= 1, hi >>= 1) {
+        if (lo & 1) {
+            if (TREE_BETTER(tree[lo], best)) {
+                best = tree[lo];
+            }
+            lo++;
+        }
+        if (hi & 1) {
+            hi--;
+            if (TREE_BETTER(tree[hi], best)) {
+                best = tree[hi];
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * Tries lengths first_len..last_len at one offset for a match ending at i.
+ * Gives the same result as trying each length in turn: the cost only
+ * changes between Elias gamma buckets, so long buckets are searched with
+ * the tree.
+ */
+static void try_lengths(zx7_t *ctx, Optimal *optimal, size_t i, int offset, size_t first_len, size_t last_len) {
+    size_t bucket_end;
+    size_t len;
+    size_t pos;
+    size_t bits;
+
+    while (first_len <= last_len) {
+        for (bucket_end = 2; bucket_end < first_len; bucket_end <<= 1) {
+        }
+        if (bucket_end > last_len) {
+            bucket_end = last_len;
+        }
+
+        if (bucket_end - first_len < 16) {
+            for (len = first_len; len <= bucket_end; len++) {
+                bits = optimal[i-len].bits + count_bits(offset, len);
+                if (optimal[i].bits > bits) {
+                    optimal[i].bits = bits;
+                    optimal[i].offset = offset;
+                    optimal[i].len = len;
+                }
+            }
+        } else {
+            pos = tree_query(ctx, optimal, i-bucket_end, i-first_len);
+            bits = optimal[pos].bits + count_bits(offset, i-pos);
+            if (optimal[i].bits > bits) {
+                optimal[i].bits = bits;
+                optimal[i].offset = offset;
+                optimal[i].len = i-pos;
+            }
+        }
+
+        first_len = bucket_end+1;
+    }
+}
+
+/* resets the scratch entries an input touched, for the next call */
+static void clear_scratch(zx7_t *ctx, unsigned char *input_data, size_t input_size) {
+    size_t i;
+
+    for (i = 1; i < input_size; i++) {
+        ctx->matches[input_data[i-1] << 8 | input_data[i]] = 0;
+    }
+    for (i = 3; i < input_size; i++) {
+        ctx->long_matches[long_match_index(input_data, i)] = 0;
+    }
+    for (i = 0; i <= MAX_OFFSET && i < input_size; i++) {
+        ctx->min[i] = 0;
+        ctx->max[i] = 0;
+    }
+}
+
+Optimal* zx7_optimize(zx7_t *ctx, unsigned char *input_data, size_t input_size) {
+    unsigned int *min;
+    unsigned int *max;
+    unsigned int *matches;
+    unsigned int *match_slots;
+    unsigned int *long_matches;
+    unsigned int *long_match_slots;
+    unsigned int *slots;
     Optimal *optimal;
-    size_t *match;
+    unsigned int *match;
     int match_index;
+    int long_index;
     int offset;
     size_t len;
     size_t best_len;
-    size_t bits;
     size_t i;
 
-    /* allocate all data structures at once */
-    min = (size_t *)calloc(MAX_OFFSET+1, sizeof(size_t));
-    max = (size_t *)calloc(MAX_OFFSET+1, sizeof(size_t));
-    matches = (size_t *)calloc(256*256, sizeof(size_t));
-    match_slots = (size_t *)calloc(input_size, sizeof(size_t));
-    optimal = (Optimal *)calloc(input_size, sizeof(Optimal));
+    if (input_size == 0 || input_size >= 0xffffffffu) {
+        return NULL;
+    }
+
+    if (allocate_scratch(ctx, input_size)) {
+        return NULL;
+    }
+
+    min = ctx->min;
+    max = ctx->max;
+    matches = ctx->matches;
+    match_slots = ctx->match_slots;
+    long_matches = ctx->long_matches;
+    long_match_slots = ctx->long_match_slots;
 
-    if (!min || !max || !matches || !match_slots || !optimal) {
-         fprintf(stderr, "Error: Insufficient memory\n");
-         exit(1);
+    optimal = (Optimal *)calloc(input_size, sizeof(Optimal));
+    if (!optimal) {
+        return NULL;
     }
 
     /* first byte is always literal */
     optimal[0].bits = 8;
+    tree_insert(ctx, optimal, 0);
+    long_index = 0;
 
     /* process remaining bytes */
     for (i = 1; i < input_size; i++) {
 
         optimal[i].bits = optimal[i-1].bits + 9;
         match_index = input_data[i-1] << 8 | input_data[i];
+        if (i >= 3) {
+            long_index = long_match_index(input_data, i);
+        }
         best_len = 1;
-        for (match = &matches[match_index]; *match != 0 && best_len < MAX_LEN; match = &match_slots[*match]) {
+        slots = match_slots;
+        match = &matches[match_index];
+        while (*match != 0 && best_len < MAX_LEN) {
             offset = i - *match;
             if (offset > MAX_OFFSET) {
                 *match = 0;
                 break;
             }
 
-            for (len = 2; len <= MAX_LEN; len++) {
-                if (len > best_len) {
-                    best_len = len;
-                    bits = optimal[i-len].bits + count_bits(offset, len);
-                    if (optimal[i].bits > bits) {
-                        optimal[i].bits = bits;
-                        optimal[i].offset = offset;
-                        optimal[i].len = len;
-                    }
-                } else if (max[offset] != 0 && i+1 == max[offset]+len) {
-                    len = i-min[offset];
-                    if (len > best_len) {
-                        len = best_len;
-                    }
+            /* larger offsets cannot be longer than best_len either */
+            if (i+1-offset <= best_len) {
+                break;
+            }
+            match = &slots[*match];
+
+            /* a longer match has to cover the byte before best_len */
+            if (best_len > 1 && input_data[i-best_len] != input_data[i-best_len-offset]) {
+                continue;
+            }
+
+            /* extend backwards, skipping what was matched at this offset before */
+            len = 2;
+            for (;;) {
+                if (max[offset] != 0 && max[offset] == i+1-len && min[offset] < max[offset]) {
+                    len = i+1-min[offset];
+                }
+                if (len >= MAX_LEN) {
+                    len = MAX_LEN;
+                    break;
                 }
                 if (i < offset+len || input_data[i-len] != input_data[i-len-offset]) {
                     break;
                 }
+                len++;
             }
             min[offset] = i+1-len;
             max[offset] = i;
+
+            if (len > best_len) {
+                try_lengths(ctx, optimal, i, offset, best_len+1, len);
+                best_len = len;
+
+                /* only matches of 4+ bytes are left, follow their shorter chain */
+                if (best_len >= 3 && slots == match_slots) {
+                    slots = long_match_slots;
+                    match = &long_matches[long_index];
+                    while (*match != 0 && i - *match <= (size_t)offset) {
+                        match = &slots[*match];
+                    }
+                }
+            }
         }
         match_slots[i] = matches[match_index];
         matches[match_index] = i;
+        if (i >= 3) {
+            long_match_slots[i] = long_matches[long_index];
+            long_matches[long_index] = i;
+        }
+        tree_insert(ctx, optimal, i);
+    }
+
+    clear_scratch(ctx, input_data, input_size);
+
+    return optimal;
+}
+
+/* adds the byte pair starting at pos to the fast match chains */
+static void insert_fast(zx7_t *ctx, unsigned char *input_data, size_t input_size, size_t pos) {
+    int match_index;
+
+    if (pos+1 < input_size) {
+        match_index = input_data[pos] << 8 | input_data[pos+1];
+        ctx->match_slots[pos] = ctx->matches[match_index];
+        ctx->matches[match_index] = pos+1;
+    }
+}
+
+/* longest match starting at pos within the first FAST_CHAIN candidates */
+static size_t find_fast(zx7_t *ctx, unsigned char *input_data, size_t input_size, size_t pos, int *offset) {
+    unsigned int match;
+    size_t max_len;
+    size_t best_len;
+    size_t len;
+    int chain;
+
+    if (pos+1 >= input_size) {
+        return 0;
+    }
+
+    max_len = input_size-pos < MAX_LEN ? input_size-pos : MAX_LEN;
+    best_len = 0;
+    chain = 0;
+    match = ctx->matches[input_data[pos] << 8 | input_data[pos+1]];
+    while (match != 0 && chain++ < FAST_CHAIN && pos-(match-1) <= MAX_OFFSET) {
+        len = 2;
+        while (len < max_len && input_data[match-1+len] == input_data[pos+len]) {
+            len++;
+        }
+        if (len > best_len) {
+            best_len = len;
+            *offset = pos-(match-1);
+            if (len >= FAST_NICE_LEN) {
+                break;
+            }
+        }
+        match = ctx->match_slots[match-1];
+    }
+    return best_len;
+}
+
+Optimal* zx7_optimize_fast(zx7_t *ctx, unsigned char *input_data, size_t input_size) {
+    Optimal *optimal;
+    size_t inserted;
+    size_t len;
+    size_t next_len;
+    size_t bits;
+    size_t i;
+    int offset;
+    int next_offset;
+
+    if (input_size == 0 || input_size >= 0xffffffffu) {
+        return NULL;
+    }
+
+    if (allocate_scratch(ctx, input_size)) {
+        return NULL;
     }
 
-    /* save time by releasing the largest block only, the O.S. will clean everything else later */
-    free(match_slots);
-    free(matches);
-    free(max);
-    free(min);
-    
+    optimal = (Optimal *)calloc(input_size, sizeof(Optimal));
+    if (!optimal) {
+        return NULL;
+    }
+
+    /* first byte is always literal */
+    bits = 8;
+    insert_fast(ctx, input_data, input_size, 0);
+    inserted = 1;
+    offset = 0;
+    next_offset = 0;
+
+    /* lazy parse: emit a literal when the next byte starts a longer match */
+    i = 1;
+    len = find_fast(ctx, input_data, input_size, i, &offset);
+    while (i < input_size) {
+        if (len >= 2 && len < FAST_LAZY_LEN) {
+            insert_fast(ctx, input_data, input_size, inserted++);
+            next_len = find_fast(ctx, input_data, input_size, i+1, &next_offset);
+            if (next_len > len) {
+                bits += 9;
+                i++;
+                len = next_len;
+                offset = next_offset;
+                continue;
+            }
+        }
+
+        if (len >= 2) {
+            i += len;
+            optimal[i-1].len = len;
+            optimal[i-1].offset = offset;
+            bits += count_bits(offset, len);
+        } else {
+            i++;
+            bits += 9;
+        }
+
+        for (; inserted < i; inserted++) {
+            insert_fast(ctx, input_data, input_size, inserted);
+        }
+        len = find_fast(ctx, input_data, input_size, i, &offset);
+    }
+    optimal[input_size-1].bits = bits;
+
+    clear_scratch(ctx, input_data, input_size);
+
     return optimal;
 }
+
+void zx7_free(zx7_t *ctx) {
+    free(ctx->tree);
+    free(ctx->long_match_slots);
+    free(ctx->long_matches);
+    free(ctx->match_slots);
+    free(ctx->matches);
+    free(ctx->max);
+    free(ctx->min);
+    ctx->match_slots = NULL;
+    ctx->matches = NULL;
+    ctx->max = NULL;
+    ctx->min = NULL;
+    ctx->match_slots_size = 0;
+    ctx->long_match_slots = NULL;
+    ctx->long_matches = NULL;
+    ctx->tree = NULL;
+    ctx->tree_size = 0;
+}
@@ -34,6 +34,33 @@ typedef struct optimal_t {
     int len;
 } Optimal;
 
-Optimal *optimize(unsigned char *input_data, size_t input_size);
+/* state for one compression at a time, several contexts can run at once */
+typedef struct zx7_t {
+    unsigned char *output_data;
+    size_t output_index;
+    size_t bit_index;
+    int bit_mask;
 
-unsigned char *compress(Optimal *optimal, unsigned char *input_data, size_t input_size, size_t *output_size, long *delta);
+    /* match finder scratch, reused between calls (zero initialize) */
+    unsigned int *min;
+    unsigned int *max;
+    unsigned int *matches;
+    unsigned int *match_slots;
+    unsigned int *long_matches;
+    unsigned int *long_match_slots;
+    size_t match_slots_size;
+
+    /* best optimal[] position over a range, for long matches */
+    unsigned int *tree;
+    size_t tree_size;
+} zx7_t;
+
+/* all return NULL on error (empty input or out of memory) */
+Optimal *zx7_optimize(zx7_t *ctx, unsigned char *input_data, size_t input_size);
+
+/* lazy greedy parse, much faster than zx7_optimize but compresses less */
+Optimal *zx7_optimize_fast(zx7_t *ctx, unsigned char *input_data, size_t input_size);
+
+void zx7_free(zx7_t *ctx);
+
+unsigned char *zx7_compress(zx7_t *ctx, Optimal *optimal, unsigned char *input_data, size_t input_size, size_t *output_size);
@@ -30,10 +30,10 @@
 
 #include "icon.h"
 #include "image.h"
+#include "remap.h"
+#include "output-formats.h"
 #include "log.h"
 
-#include "deps/libimagequant/libimagequant.h"
-
 #include <string.h>
 #include <errno.h>
 
@@ -45,13 +45,14 @@ static uint8_t icon_palette[];
 int icon_convert(icon_t *icon)
 {
     image_t image;
+    palette_t palette;
     int ret = 0;
-    liq_attr *liqattr = NULL;
-    liq_image *liqimage = NULL;
-    liq_result *liqresult = NULL;
     uint8_t *data = NULL;
     FILE *fd = NULL;
 
+    memset(&palette, 0, sizeof palette);
+    image.data = NULL;
+
     if (ret == 0)
     {
         image.path = icon->imageFile;
@@ -71,26 +72,6 @@ int icon_convert(icon_t *icon)
         }
     }
 
-    if (ret == 0)
-    {
-        liqattr = liq_attr_create();
-        if (liqattr == NULL)
-        {
-            LL_ERROR("Failed creating image attributes.");
-            ret = 1;
-        }
-    }
-
-    if (ret == 0)
-    {
-        liqimage = liq_image_create_rgba(liqattr, image.data, image.width, image.height, 0);
-        if (liqimage == NULL)
-        {
-            LL_ERROR("Failed creating image data.");
-            ret = 1;
-        }
-    }
-
     if (ret == 0)
     {
         int i;
@@ -98,37 +79,32 @@ int icon_convert(icon_t *icon)
         for (i = 0; i < 256; ++i)
         {
             unsigned int o = i * 3;
-            liq_color liqcolor;
-
-            liqcolor.r = icon_palette[o + 0];
-            liqcolor.g = icon_palette[o + 1];
-            liqcolor.b = icon_palette[o + 2];
-            liqcolor.a = 255;
+            liq_color *liqcolor = &palette.entries[i].color.rgb;
 
-            liq_image_add_fixed_color(liqimage, liqcolor);
+            liqcolor->r = icon_palette[o + 0];
+            liqcolor->g = icon_palette[o + 1];
+            liqcolor->b = icon_palette[o + 2];
+            liqcolor->a = 255;
         }
 
-        data = malloc(image.size);
-        if (data == NULL)
-        {
-            LL_DEBUG("Memory error in %s", __func__);
-            ret = 1;
-        }
+        palette.name = "icon";
+        palette.numEntries = 256;
+
+        ret = remap_build(&palette, REMAP_LIQ, 1);
     }
 
     if (ret == 0)
     {
-        liqresult = liq_quantize_image(liqattr, liqimage);
-        if (liqresult == NULL)
+        ret = remap_image(&image, &palette, REMAP_LIQ, true);
+        if (ret != 0)
         {
             LL_ERROR("Could not quantize image.");
-            ret = 1;
         }
     }
 
     if (ret == 0)
     {
-        liq_write_remapped_image(liqresult, liqimage, data, image.size);
+        data = image.data;
 
         fd = fopen(icon->outputFile, "w");
         if (fd == NULL)
@@ -140,28 +116,31 @@ int icon_convert(icon_t *icon)
 
     if (ret == 0)
     {
-        int x, y;
+        output_hex_format_t asmFormat =
+        {
+            .prefix = "$",
+            .separator = ", ",
+            .lineBreak = "\r\n\tdb\t",
+            .bytesPerLine = image.width,
+            .upper = true,
+        };
+        output_hex_format_t iceFormat =
+        {
+            .prefix = "",
+            .separator = "",
+            .lineBreak = "",
+            .bytesPerLine = 0,
+            .upper = true,
+        };
 
         if (icon->format == ICON_FORMAT_ASM)
         {
             fprintf(fd, "___icon:\r\n");
             fprintf(fd, "\tdb\t$01, $%02X, $%02X", image.width, image.height);
-            for (y = 0; y < image.height; y++)
+            if (image.size != 0)
             {
-                int offset = y * image.width;
-
                 fprintf(fd, "\r\n\tdb\t");
-                for (x = 0; x < image.width; x++)
-                {
-                    if (x + 1 == image.width)
-                    {
-                        fprintf(fd, "$%02X", data[x + offset]);
-                    }
-                    else
-                    {
-                        fprintf(fd, "$%02X, ", data[x + offset]);
-                    }
-                }
+                ret = output_hex(fd, data, image.size, &asmFormat);
             }
 
             fprintf(fd, "\r\n");
@@ -179,15 +158,7 @@ int icon_convert(icon_t *icon)
         else if (icon->format == ICON_FORMAT_ICE)
         {
             fprintf(fd, "\"01%02X%02X", image.width, image.height);
-            for (y = 0; y < image.height; y++)
-            {
-                int offset = y * image.width;
-
-                for (x = 0; x < image.width; x++)
-                {
-                    fprintf(fd, "%02X", data[x + offset]);
-                }
-            }
+            ret = output_hex(fd, data, image.size, &iceFormat);
             fprintf(fd, "\"\r\n");
         }
         else
@@ -199,10 +170,8 @@ int icon_convert(icon_t *icon)
         fclose(fd);
     }
 
-    liq_attr_destroy(liqattr);
-    liq_image_destroy(liqimage);
+    remap_free(&palette);
     free(image.data);
-    free(data);
 
     return ret;
 }
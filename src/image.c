@@ -32,27 +32,370 @@
 #include "palette.h"
 #include "log.h"
 
-#include "deps/libimagequant/libimagequant.h"
-
 #define STB_IMAGE_IMPLEMENTATION
 #include "deps/stb/stb_image.h"
 
-#include <math.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define IMAGE_RLET_SSE2
+#endif
+
+typedef struct image_cache_entry
+{
+    char *path;
+    int uses;
+    uint8_t *data;
+    int width;
+    int height;
+    size_t bytes;
+    struct image_cache_entry *hashNext;
+    struct image_cache_entry *prev;
+    struct image_cache_entry *next;
+} image_cache_entry_t;
+
+#define IMAGE_CACHE_BUCKETS 1024
+
+/*
+ * Decoded images shared between palette generation and conversion.
+ * Each path counts the loads still expected of it, so only images that
+ * are loaded again are kept, and the last load takes the buffer itself.
+ * Entries holding data are kept in a recently used list for eviction.
+ */
+static image_cache_entry_t *image_cache_buckets[IMAGE_CACHE_BUCKETS];
+static image_cache_entry_t *image_cache_head;
+static image_cache_entry_t *image_cache_tail;
+static size_t image_cache_bytes;
+static size_t image_cache_limit = IMAGE_CACHE_DEFAULT_SIZE * 1024 * 1024;
+static pthread_mutex_t image_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Hashes an image path into a cache bucket.
+ */
+static unsigned int image_cache_hash(const char *path)
+{
+    unsigned int hash = 2166136261u;
+
+    while (*path)
+    {
+        hash ^= (uint8_t)*path++;
+        hash *= 16777619u;
+    }
+
+    return hash % IMAGE_CACHE_BUCKETS;
+}
+
+/*
+ * Unlinks an entry from the recently used list.
+ */
+static void image_cache_unlink(image_cache_entry_t *entry)
+{
+    if (entry->prev != NULL)
+    {
+        entry->prev->next = entry->next;
+    }
+    else
+    {
+        image_cache_head = entry->next;
+    }
+
+    if (entry->next != NULL)
+    {
+        entry->next->prev = entry->prev;
+    }
+    else
+    {
+        image_cache_tail = entry->prev;
+    }
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/*
+ * Places an entry at the front of the recently used list.
+ */
+static void image_cache_touch(image_cache_entry_t *entry)
+{
+    entry->next = image_cache_head;
+    entry->prev = NULL;
+
+    if (image_cache_head != NULL)
+    {
+        image_cache_head->prev = entry;
+    }
+    else
+    {
+        image_cache_tail = entry;
+    }
+
+    image_cache_head = entry;
+}
+
+/*
+ * Detaches the decoded data of an entry, keeping its expected loads.
+ * Returns the data for the caller to own or free.
+ */
+static uint8_t *image_cache_detach(image_cache_entry_t *entry)
+{
+    uint8_t *data = entry->data;
+
+    if (data != NULL)
+    {
+        image_cache_unlink(entry);
+        image_cache_bytes -= entry->bytes;
+        entry->data = NULL;
+    }
+
+    return data;
+}
+
+/*
+ * Finds a cached path, must be called with the lock held.
+ */
+static image_cache_entry_t *image_cache_find(const char *path)
+{
+    image_cache_entry_t *entry;
+
+    entry = image_cache_buckets[image_cache_hash(path)];
+    while (entry != NULL && strcmp(entry->path, path))
+    {
+        entry = entry->hashNext;
+    }
+
+    return entry;
+}
+
+/*
+ * Registers one future load of a path, so that its decoded image
+ * is kept until that load.
+ */
+void image_cache_expect(const char *path)
+{
+    image_cache_entry_t *entry;
+    unsigned int bucket;
+
+    if (path == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&image_cache_lock);
+
+    entry = image_cache_find(path);
+    if (entry == NULL)
+    {
+        entry = calloc(1, sizeof(image_cache_entry_t));
+        if (entry == NULL)
+        {
+            pthread_mutex_unlock(&image_cache_lock);
+            return;
+        }
+
+        entry->path = strdup(path);
+        if (entry->path == NULL)
+        {
+            free(entry);
+            pthread_mutex_unlock(&image_cache_lock);
+            return;
+        }
+
+        bucket = image_cache_hash(path);
+        entry->hashNext = image_cache_buckets[bucket];
+        image_cache_buckets[bucket] = entry;
+    }
+
+    entry->uses++;
+
+    pthread_mutex_unlock(&image_cache_lock);
+}
+
+/*
+ * Drops an expected load of a path that was satisfied some other way,
+ * such as from the conversion cache.
+ */
+void image_cache_skip(const char *path)
+{
+    image_cache_entry_t *entry;
+
+    if (path == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&image_cache_lock);
+
+    entry = image_cache_find(path);
+    if (entry != NULL && entry->uses > 0 && --entry->uses == 0)
+    {
+        free(image_cache_detach(entry));
+    }
+
+    pthread_mutex_unlock(&image_cache_lock);
+}
+
+/*
+ * Takes a cached image for one expected load, returns 0 on hit.
+ * The last expected load gets the cached buffer, earlier ones a copy.
+ */
+static int image_cache_get(image_t *image)
+{
+    image_cache_entry_t *entry;
+    int ret = 1;
+
+    pthread_mutex_lock(&image_cache_lock);
+
+    entry = image_cache_find(image->path);
+    if (entry != NULL)
+    {
+        if (entry->uses > 0)
+        {
+            entry->uses--;
+        }
+
+        if (entry->data != NULL)
+        {
+            image->width = entry->width;
+            image->height = entry->height;
+
+            if (entry->uses == 0)
+            {
+                image->data = image_cache_detach(entry);
+            }
+            else
+            {
+                image->data = malloc(entry->bytes);
+                if (image->data != NULL)
+                {
+                    memcpy(image->data, entry->data, entry->bytes);
+                }
+
+                image_cache_unlink(entry);
+                image_cache_touch(entry);
+            }
+
+            ret = image->data == NULL ? 1 : 0;
+        }
+    }
+
+    pthread_mutex_unlock(&image_cache_lock);
+
+    return ret;
+}
+
+/*
+ * Stores a copy of a decoded image if more loads of it are expected,
+ * evicting old ones to stay in budget.
+ */
+static void image_cache_put(const image_t *image)
+{
+    image_cache_entry_t *entry;
+    size_t bytes = (size_t)image->width * image->height * 4;
+
+    if (bytes > image_cache_limit)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&image_cache_lock);
+
+    entry = image_cache_find(image->path);
+    if (entry == NULL || entry->uses == 0 || entry->data != NULL)
+    {
+        pthread_mutex_unlock(&image_cache_lock);
+        return;
+    }
+
+    while (image_cache_bytes + bytes > image_cache_limit)
+    {
+        free(image_cache_detach(image_cache_tail));
+    }
+
+    entry->data = malloc(bytes);
+    if (entry->data == NULL)
+    {
+        pthread_mutex_unlock(&image_cache_lock);
+        return;
+    }
+
+    memcpy(entry->data, image->data, bytes);
+    entry->width = image->width;
+    entry->height = image->height;
+    entry->bytes = bytes;
+
+    image_cache_touch(entry);
+    image_cache_bytes += bytes;
+
+    pthread_mutex_unlock(&image_cache_lock);
+}
+
+/*
+ * Sets the memory budget of the decoded image cache in MiB, 0 disables.
+ */
+void image_cache_set_size(int mib)
+{
+    pthread_mutex_lock(&image_cache_lock);
+
+    image_cache_limit = mib <= 0 ? 0 : (size_t)mib * 1024 * 1024;
+    while (image_cache_bytes > image_cache_limit)
+    {
+        free(image_cache_detach(image_cache_tail));
+    }
+
+    pthread_mutex_unlock(&image_cache_lock);
+}
+
+/*
+ * Frees all cached images and expected loads.
+ */
+void image_cache_clear(void)
+{
+    int i;
+
+    pthread_mutex_lock(&image_cache_lock);
+
+    for (i = 0; i < IMAGE_CACHE_BUCKETS; ++i)
+    {
+        while (image_cache_buckets[i] != NULL)
+        {
+            image_cache_entry_t *entry = image_cache_buckets[i];
+
+            image_cache_buckets[i] = entry->hashNext;
+            free(image_cache_detach(entry));
+            free(entry->path);
+            free(entry);
+        }
+    }
+
+    pthread_mutex_unlock(&image_cache_lock);
+}
 
 /*
  * Loads an image to its data array.
+ * Images loaded more than once are decoded once and shared through the cache.
  */
 int image_load(image_t *image)
 {
     int channels;
-    image->data = (uint8_t *)stbi_load(image->path,
-                                       &image->width,
-                                       &image->height,
-                                       &channels,
-                                       STBI_rgb_alpha);
+
+    if (image_cache_get(image) != 0)
+    {
+        image->data = (uint8_t *)stbi_load(image->path,
+                                           &image->width,
+                                           &image->height,
+                                           &channels,
+                                           STBI_rgb_alpha);
+        if (image->data != NULL)
+        {
+            image_cache_put(image);
+        }
+    }
 
     image->size = image->width * image->height;
     image->compressed = false;
+    image->compress = COMPRESS_NONE;
 
     return image->data == NULL ? 1 : 0;
 }
@@ -100,116 +443,272 @@ int image_add_width_and_height(image_t *image)
 }
 
 /*
- * Converts image to RLET encoded.
+ * Gets the worst case RLET size, reached by alternating single
+ * opaque and transparent pixels.
  */
-int image_rlet(image_t *image, int tIndex)
+static int image_rlet_bound(int width, int height)
 {
-    uint8_t *newData = calloc(image->width * image->height * 2, sizeof(uint8_t));
-    int newSize = 0;
-    int i;
+    return height * (width + (width + 1) / 2 + 2);
+}
 
-    if (newData == NULL)
+/*
+ * Counts the leading pixels that are (or are not) the transparent index.
+ */
+static int image_rlet_span(const uint8_t *data, int left, int tIndex, bool transparent)
+{
+    int n = 0;
+
+    if (tIndex < 0 || tIndex > 255)
     {
-        LL_DEBUG("Memory error in %s", __func__);
-        return 1;
+        return transparent ? 0 : left;
     }
 
-    if (tIndex < 0)
+#ifdef IMAGE_RLET_SSE2
     {
-        LL_ERROR("Transparent color index not specified for RLET mode.");
-        return 1;
+        const __m128i t = _mm_set1_epi8((char)tIndex);
+        const int invert = transparent ? 0xffff : 0;
+
+        for (; n + 16 <= left; n += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(data + n));
+            int stop = _mm_movemask_epi8(_mm_cmpeq_epi8(v, t)) ^ invert;
+
+            if (stop)
+            {
+                return n + __builtin_ctz(stop);
+            }
+        }
+    }
+#endif
+
+    while (n < left && (data[n] == tIndex) == transparent)
+    {
+        n++;
     }
 
-    for (i = 0; i < image->height; i++)
+    return n;
+}
+
+/*
+ * Encodes indexed pixels as RLET, returns the encoded size.
+ */
+static int image_rlet_encode(const uint8_t *data, int width, int height, int tIndex, uint8_t *newData)
+{
+    int newSize = 0;
+    int i;
+
+    for (i = 0; i < height; i++)
     {
-        int offset = i * image->width;
-        int left = image->width;
+        const uint8_t *row = &data[i * width];
+        int left = width;
 
         while (left)
         {
             int o, t;
 
-            t = o = 0;
-            while (t < left && tIndex == image->data[t + offset])
-            {
-                t++;
-            }
+            t = image_rlet_span(row, left, tIndex, true);
+            row += t;
 
             newData[newSize] = t;
             newSize++;
 
             if ((left -= t))
             {
-                uint8_t *opaqueLen = &newData[newSize];
-                newSize++;
+                o = image_rlet_span(row, left, tIndex, false);
 
-                while (o < left && tIndex != image->data[t + o + offset])
-                {
-                    newData[newSize] = image->data[t + o + offset];
-                    newSize++;
-                    o++;
-                }
+                newData[newSize] = o;
+                memcpy(&newData[newSize + 1], row, o);
+                newSize += o + 1;
 
-                *opaqueLen = o;
+                row += o;
                 left -= o;
             }
-
-            offset += o + t;
         }
     }
 
+    return newSize;
+}
+
+/*
+ * Converts image to RLET encoded.
+ */
+int image_rlet(image_t *image, int tIndex)
+{
+    uint8_t *newData;
+
+    if (tIndex < 0)
+    {
+        LL_ERROR("Transparent color index not specified for RLET mode.");
+        return 1;
+    }
+
+    newData = malloc(image_rlet_bound(image->width, image->height));
+    if (newData == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    image->size = image_rlet_encode(image->data, image->width, image->height, tIndex, newData);
+
     free(image->data);
     image->data = newData;
-    image->size = newSize;
 
     return 0;
 }
 
 /*
- * Sets the bpp for the converted image.
+ * Gets the number of pixels packed in each byte for a bpp mode.
+ * Returns 0 if the palette does not fit.
  */
-int image_set_bpp(image_t *image, bpp_t bpp, int paletteNumEntries)
+static int image_bpp_pixels(bpp_t bpp, int paletteNumEntries)
 {
-    int shift;
-    int inc;
-    int j, k;
-    int newSize;
-    uint8_t *newData;
-
     switch (bpp)
     {
         case BPP_1:
             if (paletteNumEntries > 2)
             {
                 LL_ERROR("Palette has too many entries for BPP mode. (max 2)");
-                return 1;
+                return 0;
             }
-            shift = 3;
-            break;
+            return 8;
         case BPP_2:
             if (paletteNumEntries > 4)
             {
                 LL_ERROR("Palette has too many entries for BPP mode. (max 4)");
-                return 1;
+                return 0;
             }
-            shift = 2;
-            break;
+            return 4;
         case BPP_4:
             if (paletteNumEntries > 16)
             {
                 LL_ERROR("Palette has too many entries for BPP mode. (max 16)");
-                return 1;
+                return 0;
             }
-            shift = 1;
-            break;
+            return 2;
         case BPP_8:
-            return 0;
+            return 1;
         default:
             LL_ERROR("Invalid BPP mode.");
-            return 1;
+            return 0;
+    }
+}
+
+/*
+ * Packs 1bpp pixels into bytes, first pixel in the high bit.
+ */
+static void image_bpp_pack_1(const uint8_t *src, uint8_t *dst, int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i, src += 8)
+    {
+        dst[i] = (src[0] << 7) | (src[1] << 6) | (src[2] << 5) | (src[3] << 4) |
+                 (src[4] << 3) | (src[5] << 2) | (src[6] << 1) | src[7];
+    }
+}
+
+/*
+ * Packs 2bpp pixels into bytes, first pixel in the high bits.
+ */
+static void image_bpp_pack_2(const uint8_t *src, uint8_t *dst, int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i, src += 4)
+    {
+        dst[i] = (src[0] << 6) | (src[1] << 4) | (src[2] << 2) | src[3];
+    }
+}
+
+/*
+ * Packs 4bpp pixels into bytes, first pixel in the high nibble.
+ */
+static void image_bpp_pack_4(const uint8_t *src, uint8_t *dst, int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i, src += 2)
+    {
+        dst[i] = (src[0] << 4) | src[1];
+    }
+}
+
+/*
+ * Packs a run of pixels into bytes, padding the last byte with zeros.
+ * Returns the packed size.
+ */
+static int image_bpp_pack_run(const uint8_t *src, int numPixels, int inc, uint8_t *dst)
+{
+    void (*pack)(const uint8_t *, uint8_t *, int);
+    int full = numPixels / inc;
+    int rem = numPixels % inc;
+
+    switch (inc)
+    {
+        case 8:
+            pack = image_bpp_pack_1;
+            break;
+        case 4:
+            pack = image_bpp_pack_2;
+            break;
+        default:
+            pack = image_bpp_pack_4;
+            break;
+    }
+
+    pack(src, dst, full);
+
+    if (rem != 0)
+    {
+        uint8_t tail[8] = { 0 };
+
+        memcpy(tail, src + full * inc, rem);
+        pack(tail, dst + full, 1);
+        full++;
+    }
+
+    return full;
+}
+
+/*
+ * Packs rows of pixels into bytes, returns the packed size.
+ * Each row starts on a byte boundary.
+ */
+static int image_bpp_pack(const uint8_t *data, int width, int height, int inc, uint8_t *newData)
+{
+    int newSize = 0;
+    int j;
+
+    for (j = 0; j < height; ++j)
+    {
+        newSize += image_bpp_pack_run(&data[j * width], width, inc, &newData[newSize]);
+    }
+
+    return newSize;
+}
+
+/*
+ * Sets the bpp for the converted image.
+ * Data that is no longer row aligned (e.g. after omits) is packed as a
+ * single stream.
+ */
+int image_set_bpp(image_t *image, bpp_t bpp, int paletteNumEntries)
+{
+    int inc;
+    uint8_t *newData;
+
+    inc = image_bpp_pixels(bpp, paletteNumEntries);
+    if (inc == 0)
+    {
+        return 1;
+    }
+
+    if (inc == 1)
+    {
+        return 0;
     }
 
-    newSize = 0;
     newData = malloc(image->size);
     if (newData == NULL)
     {
@@ -217,35 +716,52 @@ int image_set_bpp(image_t *image, bpp_t bpp, int paletteNumEntries)
         return 1;
     }
 
-    inc = pow(2, shift);
-
-    for (j = 0; j < image->height; ++j)
+    if (image->size == image->width * image->height)
     {
-        int line = j * image->width;
+        image->size = image_bpp_pack(image->data, image->width, image->height, inc, newData);
+    }
+    else
+    {
+        image->size = image_bpp_pack_run(image->data, image->size, inc, newData);
+    }
 
-        for (k = 0; k < image->width; k += inc)
-        {
-            int currInc = inc;
-            int col;
-            uint8_t byte = 0;
+    free(image->data);
+    image->data = newData;
 
-            for (col = 0; col < inc; col++)
-            {
-                byte |= image->data[k + line + col] << --currInc;
-            }
+    image->width = (image->width + inc - 1) / inc;
 
-            newData[newSize] = byte;
-            newSize++;
+    return 0;
+}
+
+/*
+ * Copies data without the omitted indices, returns the new size.
+ */
+static int image_omit_filter(const uint8_t *data, int size, const int *omitIndices, int numOmitIndices, uint8_t *newData)
+{
+    uint32_t keep[256 / 32];
+    int newSize = 0;
+    int i;
+
+    memset(keep, 0xff, sizeof keep);
+
+    for (i = 0; i < numOmitIndices; ++i)
+    {
+        if (omitIndices[i] >= 0 && omitIndices[i] <= 255)
+        {
+            keep[omitIndices[i] >> 5] &= ~(UINT32_C(1) << (omitIndices[i] & 31));
         }
     }
 
-    free(image->data);
-    image->data = newData;
+    /* always store, only advance when the index is kept */
+    for (i = 0; i < size; ++i)
+    {
+        uint8_t index = data[i];
 
-    image->width /= inc;
-    image->size = image->width * image->height;
+        newData[newSize] = index;
+        newSize += (keep[index >> 5] >> (index & 31)) & 1;
+    }
 
-    return 0;
+    return newSize;
 }
 
 /*
@@ -254,8 +770,6 @@ int image_set_bpp(image_t *image, bpp_t bpp, int paletteNumEntries)
  */
 int image_remove_omits(image_t *image, int *omitIndices, int numOmitIndices)
 {
-    int i, j;
-    int newSize = 0;
     uint8_t *newData;
 
     if (numOmitIndices == 0)
@@ -269,120 +783,230 @@ int image_remove_omits(image_t *image, int *omitIndices, int numOmitIndices)
         return 1;
     }
 
-    for (i = 0; i < image->size; ++i)
+    image->size = image_omit_filter(image->data, image->size, omitIndices, numOmitIndices, newData);
+
+    free(image->data);
+    image->data = newData;
+
+    return 0;
+}
+
+/*
+ * Applies each transform as a separate pass.
+ * Used for combinations where the passes feed each other's output.
+ */
+static int image_transform_staged(image_t *image, const image_transform_t *transform)
+{
+    int ret;
+
+    if (transform->rlet)
     {
-        for (j = 0; j < numOmitIndices; ++j)
+        ret = image_rlet(image, transform->transparentIndex);
+        if (ret != 0)
         {
-            if (image->data[i] == omitIndices[j])
-            {
-                goto nextbyte;
-            }
+            return ret;
         }
+    }
+
+    ret = image_remove_omits(image, transform->omitIndices, transform->numOmitIndices);
+    if (ret != 0)
+    {
+        return ret;
+    }
 
-        newData[newSize] = image->data[i];
-        newSize++;
+    ret = image_set_bpp(image, transform->bpp, transform->paletteNumEntries);
+    if (ret != 0)
+    {
+        return ret;
+    }
 
-nextbyte:
-        continue;
+    if (transform->widthAndHeight)
+    {
+        ret = image_add_width_and_height(image);
     }
 
-    free(image->data);
-    image->data = newData;
-    image->size = newSize;
+    return ret;
+}
 
-    return 0;
+/*
+ * Gets the largest size a transform can produce.
+ */
+int image_transform_bound(const image_t *image, const image_transform_t *transform)
+{
+    int header = transform->widthAndHeight ? WIDTH_HEIGHT_SIZE : 0;
+
+    return header + (transform->rlet ?
+        image_rlet_bound(image->width, image->height) : image->size);
 }
 
 /*
- * Compresses data (includes width and height if they exist).
- * Reallocs array as needed.
+ * Transforms converted indices into the output format, writing to dst
+ * which must hold image_transform_bound bytes. On success the image
+ * refers to dst; the previous data is left to the caller.
+ * Common combinations are done in a single pass.
  */
-int image_compress(image_t *image, compress_t compress)
+int image_transform_to(image_t *image, const image_transform_t *transform, uint8_t *dst)
 {
-    size_t newSize;
-    int ret = 0;
+    int header = transform->widthAndHeight ? WIDTH_HEIGHT_SIZE : 0;
+    int inc;
+    int newSize;
 
-    if (image == NULL)
+    if (image == NULL || transform == NULL || dst == NULL)
     {
         LL_DEBUG("Invalid param in %s", __func__);
         return 1;
     }
 
-    if (compress == COMPRESS_NONE)
+    inc = image_bpp_pixels(transform->bpp, transform->paletteNumEntries);
+    if (inc == 0)
     {
-        return 0;
+        return 1;
     }
 
-    newSize = image->size;
-    ret = compress_array(&image->data, &newSize, compress);
-    image->size = newSize;
+    if ((transform->rlet && (transform->numOmitIndices != 0 || inc != 1)) ||
+        (transform->numOmitIndices != 0 && inc != 1))
+    {
+        image_t staged = *image;
+        int ret;
 
-    return ret;
+        staged.data = malloc(image->size + 1);
+        if (staged.data == NULL)
+        {
+            LL_DEBUG("Memory error in %s", __func__);
+            return 1;
+        }
+
+        memcpy(staged.data, image->data, image->size);
+
+        ret = image_transform_staged(&staged, transform);
+        if (ret == 0)
+        {
+            memcpy(dst, staged.data, staged.size);
+            image->data = dst;
+            image->size = staged.size;
+            image->width = staged.width;
+        }
+
+        free(staged.data);
+
+        return ret;
+    }
+
+    if (transform->rlet && transform->transparentIndex < 0)
+    {
+        LL_ERROR("Transparent color index not specified for RLET mode.");
+        return 1;
+    }
+
+    if (transform->rlet)
+    {
+        newSize = image_rlet_encode(image->data,
+                                    image->width,
+                                    image->height,
+                                    transform->transparentIndex,
+                                    dst + header);
+    }
+    else if (transform->numOmitIndices != 0)
+    {
+        newSize = image_omit_filter(image->data,
+                                    image->size,
+                                    transform->omitIndices,
+                                    transform->numOmitIndices,
+                                    dst + header);
+    }
+    else if (inc != 1)
+    {
+        newSize = image_bpp_pack(image->data,
+                                 image->width,
+                                 image->height,
+                                 inc,
+                                 dst + header);
+        image->width = (image->width + inc - 1) / inc;
+    }
+    else
+    {
+        memcpy(dst + header, image->data, image->size);
+        newSize = image->size;
+    }
+
+    if (header != 0)
+    {
+        dst[0] = image->width;
+        dst[1] = image->height;
+    }
+
+    image->data = dst;
+    image->size = newSize + header;
+
+    return 0;
 }
 
 /*
- * Quantizes an image against a palette.
+ * Transforms converted indices into the output format.
  */
-int image_quantize(image_t *image, palette_t *palette)
+int image_transform(image_t *image, const image_transform_t *transform)
 {
-    int j;
-    liq_image *liqimage = NULL;
-    liq_result *liqresult = NULL;
-    liq_attr *liqattr = NULL;
-    uint8_t *data = NULL;
+    uint8_t *oldData;
+    uint8_t *newData;
+    int ret;
 
-    liqattr = liq_attr_create();
-    if (liqattr == NULL)
+    if (image == NULL || transform == NULL)
     {
-        LL_ERROR("Failed to create image attributes \'%s\'\n", image->path);
+        LL_DEBUG("Invalid param in %s", __func__);
         return 1;
     }
 
-    liq_set_speed(liqattr, 10);
-    liq_set_max_colors(liqattr, palette->numEntries);
-    liqimage = liq_image_create_rgba(liqattr,
-                                     image->data,
-                                     image->width,
-                                     image->height,
-                                     0);
-    if (liqimage == NULL)
+    newData = malloc(image_transform_bound(image, transform));
+    if (newData == NULL)
     {
-        LL_ERROR("Failed to create image \'%s\'\n", image->path);
-        liq_attr_destroy(liqattr);
+        LL_DEBUG("Memory error in %s", __func__);
         return 1;
     }
 
-    for (j = 0; j < palette->numEntries; j++)
+    oldData = image->data;
+
+    ret = image_transform_to(image, transform, newData);
+    if (ret != 0)
     {
-        liq_image_add_fixed_color(liqimage, palette->entries[j].color.rgb);
+        free(newData);
+        return ret;
     }
 
-    liqresult = liq_quantize_image(liqattr, liqimage);
-    if (liqresult == NULL)
+    free(oldData);
+
+    return 0;
+}
+
+/*
+ * Compresses data (includes width and height if they exist).
+ * Reallocs array as needed. With COMPRESS_AUTO the data may stay raw.
+ */
+int image_compress(image_t *image, compress_t compress, compress_level_t level)
+{
+    size_t newSize;
+    int ret = 0;
+
+    if (image == NULL)
     {
-        LL_ERROR("Failed to quantize image \'%s\'\n", image->path);
-        liq_image_destroy(liqimage);
-        liq_attr_destroy(liqattr);
+        LL_DEBUG("Invalid param in %s", __func__);
         return 1;
     }
 
-    data = malloc(image->size);
-    if (data == NULL)
+    if (compress == COMPRESS_NONE)
     {
-        LL_ERROR("Failed to allocate image memory \'%s\'\n", image->path);
-        liq_result_destroy(liqresult);
-        liq_image_destroy(liqimage);
-        liq_attr_destroy(liqattr);
-        return 1;
+        return 0;
     }
 
-    liq_write_remapped_image(liqresult, liqimage, data, image->size);
-    free(image->data);
-    image->data = data;
+    newSize = image->size;
+    ret = compress_array(&image->data, &newSize, &compress, level);
+    if (ret != 0)
+    {
+        return ret;
+    }
 
-    liq_result_destroy(liqresult);
-    liq_image_destroy(liqimage);
-    liq_attr_destroy(liqattr);
+    image->size = newSize;
+    image->compress = compress;
+    image->compressed = compress != COMPRESS_NONE;
 
     return 0;
 }
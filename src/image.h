@@ -52,6 +52,8 @@ typedef struct
 
     /* set by convert */
     bool compressed;
+    compress_t compress;
+    bool compressAuto;
     bool rlet;
 
     /* set by output */
@@ -60,16 +62,33 @@ typedef struct
 
 #define WIDTH_HEIGHT_SIZE 2
 
-/* I despise forward declartions, but meh */
-typedef struct palette palette_t;
+typedef struct
+{
+    bool rlet;
+    int transparentIndex;
+    int *omitIndices;
+    int numOmitIndices;
+    bpp_t bpp;
+    int paletteNumEntries;
+    bool widthAndHeight;
+} image_transform_t;
+
+/* default decoded image cache budget in MiB */
+#define IMAGE_CACHE_DEFAULT_SIZE 256
 
 int image_load(image_t *image);
+void image_cache_expect(const char *path);
+void image_cache_skip(const char *path);
+void image_cache_set_size(int mib);
+void image_cache_clear(void);
 int image_rlet(image_t *image, int tIndex);
 int image_add_width_and_height(image_t *image);
-int image_compress(image_t *image, compress_t compress);
+int image_compress(image_t *image, compress_t compress, compress_level_t level);
 int image_remove_omits(image_t *image, int *omitIndices, int numOmitIndices);
 int image_set_bpp(image_t *image, bpp_t bpp, int paletteNumEntries);
-int image_quantize(image_t *image, palette_t *palette);
+int image_transform_bound(const image_t *image, const image_transform_t *transform);
+int image_transform_to(image_t *image, const image_transform_t *transform, uint8_t *dst);
+int image_transform(image_t *image, const image_transform_t *transform);
 void image_free(image_t *image);
 
 #ifdef __cplusplus
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2017-2019 Matt "MateoConLechuga" Waltz
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lz4.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Raw LZ4 block format, so any block decompressor can unpack the output.
+ * The format requires the last 5 bytes to be literals, and the last match
+ * to start at least 12 bytes before the end of the block.
+ */
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_LIMIT 12
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 16
+#define LZ4_NO_POS -1
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    int32_t *head;
+    int32_t *prev;
+    size_t inserted;
+    int maxChain;
+    uint8_t *output;
+    size_t outputSize;
+} lz4_state_t;
+
+static inline uint32_t lz4_hash(const uint8_t *ptr)
+{
+    uint32_t value;
+
+    value = (uint32_t)ptr[0] |
+            ((uint32_t)ptr[1] << 8) |
+            ((uint32_t)ptr[2] << 16) |
+            ((uint32_t)ptr[3] << 24);
+
+    return (value * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/*
+ * Adds every position before pos to the match chains.
+ */
+static void lz4_insert(lz4_state_t *state, size_t pos)
+{
+    for (; state->inserted < pos; state->inserted++)
+    {
+        size_t i = state->inserted;
+        uint32_t hash;
+
+        if (i + LZ4_MIN_MATCH > state->size)
+        {
+            continue;
+        }
+
+        hash = lz4_hash(&state->data[i]);
+        state->prev[i] = state->head[hash];
+        state->head[hash] = (int32_t)i;
+    }
+}
+
+/*
+ * Finds the longest match starting at pos.
+ * Returns the match length, or 0 if there is none.
+ */
+static size_t lz4_find(lz4_state_t *state, size_t pos, size_t *offset)
+{
+    const uint8_t *data = state->data;
+    size_t maxLen;
+    size_t bestLen = 0;
+    int32_t candidate;
+    int chain = state->maxChain;
+
+    if (pos + LZ4_MATCH_LIMIT > state->size)
+    {
+        return 0;
+    }
+
+    lz4_insert(state, pos);
+
+    maxLen = state->size - LZ4_LAST_LITERALS - pos;
+    candidate = state->head[lz4_hash(&data[pos])];
+    while (candidate != LZ4_NO_POS &&
+           pos - (size_t)candidate <= LZ4_MAX_OFFSET &&
+           chain-- > 0)
+    {
+        const uint8_t *match = &data[candidate];
+
+        if (!memcmp(match, &data[pos], LZ4_MIN_MATCH) &&
+            match[bestLen] == data[pos + bestLen])
+        {
+            size_t len = LZ4_MIN_MATCH;
+
+            while (len < maxLen && match[len] == data[pos + len])
+            {
+                len++;
+            }
+
+            if (len > bestLen)
+            {
+                bestLen = len;
+                *offset = pos - (size_t)candidate;
+                if (len == maxLen)
+                {
+                    break;
+                }
+            }
+        }
+
+        candidate = state->prev[candidate];
+    }
+
+    return bestLen >= LZ4_MIN_MATCH ? bestLen : 0;
+}
+
+/*
+ * Writes a token length field overflow as a run of 255 bytes.
+ */
+static void lz4_write_length(lz4_state_t *state, size_t len)
+{
+    while (len >= 255)
+    {
+        state->output[state->outputSize++] = 255;
+        len -= 255;
+    }
+
+    state->output[state->outputSize++] = (uint8_t)len;
+}
+
+/*
+ * Writes one sequence: literals followed by an optional match.
+ */
+static void lz4_write_sequence(lz4_state_t *state,
+                               size_t literals,
+                               size_t numLiterals,
+                               size_t offset,
+                               size_t matchLen)
+{
+    size_t matchCode = matchLen ? matchLen - LZ4_MIN_MATCH : 0;
+    uint8_t token;
+
+    token = (uint8_t)((numLiterals < 15 ? numLiterals : 15) << 4);
+    token |= (uint8_t)(matchCode < 15 ? matchCode : 15);
+    state->output[state->outputSize++] = token;
+
+    if (numLiterals >= 15)
+    {
+        lz4_write_length(state, numLiterals - 15);
+    }
+
+    memcpy(&state->output[state->outputSize], &state->data[literals], numLiterals);
+    state->outputSize += numLiterals;
+
+    if (matchLen == 0)
+    {
+        return;
+    }
+
+    state->output[state->outputSize++] = (uint8_t)(offset & 255);
+    state->output[state->outputSize++] = (uint8_t)(offset >> 8);
+
+    if (matchCode >= 15)
+    {
+        lz4_write_length(state, matchCode - 15);
+    }
+}
+
+/*
+ * Allocates the match finder tables, or grows them for a larger input.
+ * The head table is cleared once here and reset after each use.
+ */
+static int lz4_alloc(lz4_t *ctx, size_t size)
+{
+    size_t i;
+
+    if (ctx->head == NULL)
+    {
+        ctx->head = malloc((1 << LZ4_HASH_BITS) * sizeof(int32_t));
+        if (ctx->head == NULL)
+        {
+            return 1;
+        }
+
+        for (i = 0; i < (1 << LZ4_HASH_BITS); ++i)
+        {
+            ctx->head[i] = LZ4_NO_POS;
+        }
+    }
+
+    if (ctx->prevSize < size + 1)
+    {
+        int32_t *prev = realloc(ctx->prev, (size + 1) * sizeof(int32_t));
+        if (prev == NULL)
+        {
+            return 1;
+        }
+
+        ctx->prev = prev;
+        ctx->prevSize = size + 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Compresses data as a single LZ4 block.
+ * The fast mode searches fewer candidates and skips the lazy lookahead.
+ * Returns 0 on success, with a newly allocated output.
+ */
+int lz4_compress(lz4_t *ctx, const uint8_t *data, size_t size, bool fast,
+                 uint8_t **output, size_t *outputSize)
+{
+    lz4_state_t state;
+    size_t literals = 0;
+    size_t pos = 0;
+    size_t i;
+
+    if (ctx == NULL || data == NULL || output == NULL || outputSize == NULL ||
+        size > INT32_MAX)
+    {
+        LL_DEBUG("Invalid param in %s", __func__);
+        return 1;
+    }
+
+    state.output = malloc(size + size / 255 + 16);
+    if (state.output == NULL || lz4_alloc(ctx, size))
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        free(state.output);
+        return 1;
+    }
+
+    state.data = data;
+    state.size = size;
+    state.head = ctx->head;
+    state.prev = ctx->prev;
+    state.inserted = 0;
+    state.maxChain = fast ? 16 : 256;
+    state.outputSize = 0;
+
+    while (pos < size)
+    {
+        size_t offset = 0;
+        size_t len;
+
+        len = lz4_find(&state, pos, &offset);
+        if (len == 0)
+        {
+            pos++;
+            continue;
+        }
+
+        /* emit a literal instead if the next position matches longer */
+        if (!fast)
+        {
+            size_t nextOffset = 0;
+            size_t nextLen;
+
+            while ((nextLen = lz4_find(&state, pos + 1, &nextOffset)) > len)
+            {
+                pos++;
+                len = nextLen;
+                offset = nextOffset;
+            }
+        }
+
+        lz4_write_sequence(&state, literals, pos - literals, offset, len);
+        pos += len;
+        literals = pos;
+    }
+
+    lz4_write_sequence(&state, literals, size - literals, 0, 0);
+
+    /* only the hashes of inserted positions were touched */
+    for (i = 0; i < state.inserted && i + LZ4_MIN_MATCH <= size; ++i)
+    {
+        state.head[lz4_hash(&data[i])] = LZ4_NO_POS;
+    }
+
+    *output = state.output;
+    *outputSize = state.outputSize;
+
+    return 0;
+}
+
+/*
+ * Releases the match finder tables.
+ */
+void lz4_free(lz4_t *ctx)
+{
+    free(ctx->head);
+    free(ctx->prev);
+    ctx->head = NULL;
+    ctx->prev = NULL;
+    ctx->prevSize = 0;
+}
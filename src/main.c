@@ -31,8 +31,31 @@
 #include "options.h"
 #include "convert.h"
 #include "icon.h"
+#include "thread.h"
+#include "cache.h"
+#include "compress.h"
 #include "log.h"
 
+/*
+ * Generates a single palette, used as a thread job.
+ */
+static int main_generate_palette(void *arg, int index)
+{
+    yaml_file_t *yamlfile = arg;
+    palette_t *palette = yamlfile->palettes[index];
+    int ret;
+
+    ret = palette_generate(palette,
+                           yamlfile->converts,
+                           yamlfile->numConverts);
+    if (ret != 0)
+    {
+        LL_ERROR("Failed to generate palette \'%s\'", palette->name);
+    }
+
+    return ret;
+}
+
 /*
  * Main entry function, cli arguments.
  */
@@ -69,21 +92,30 @@ int main(int argc, char **argv)
             }
         }
 
-        /* generate palettes */
+        /* count image loads so only reused images stay decoded */
         if (ret == 0)
         {
             for (i = 0; i < yamlfile->numPalettes; ++i)
             {
-                ret = palette_generate(yamlfile->palettes[i],
-                                       yamlfile->converts,
-                                       yamlfile->numConverts);
-                if (ret != 0)
-                {
-                    break;
-                }
+                palette_expect_images(yamlfile->palettes[i],
+                                      yamlfile->converts,
+                                      yamlfile->numConverts);
+            }
+
+            for (i = 0; i < yamlfile->numConverts; ++i)
+            {
+                convert_expect_images(yamlfile->converts[i]);
             }
         }
 
+        /* generate palettes */
+        if (ret == 0)
+        {
+            ret = thread_run(main_generate_palette,
+                             yamlfile,
+                             yamlfile->numPalettes);
+        }
+
         /* convert images using palettes */
         if (ret == 0)
         {
@@ -134,8 +166,15 @@ int main(int argc, char **argv)
             }
         }
 
+        cache_log_stats();
+
         yaml_release_file(yamlfile);
     }
 
+    image_cache_clear();
+    cache_free();
+    compress_free();
+    thread_shutdown();
+
     return ret == OPTIONS_IGNORE ? 0 : ret;
 }
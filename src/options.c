@@ -30,6 +30,9 @@
 
 #include "options.h"
 #include "version.h"
+#include "thread.h"
+#include "image.h"
+#include "cache.h"
 #include "log.h"
 
 #include <getopt.h>
@@ -62,6 +65,11 @@ static void options_show(const char *prgm)
     LL_PRINT("    -v, --version            Show program version.\n");
     LL_PRINT("    -l, --log-level <level>  Set program logging level.\n");
     LL_PRINT("                             0=none, 1=error, 2=warning, 3=normal\n");
+    LL_PRINT("    -j, --threads <num>      Number of threads used for conversion.\n");
+    LL_PRINT("                             0=use all processors, default is 1.\n");
+    LL_PRINT("    --image-cache <mib>      Memory budget for decoded images in MiB.\n");
+    LL_PRINT("                             0=disable cache, default is 256.\n");
+    LL_PRINT("    --cache-dir <dir>        Reuse conversions stored in this directory.\n");
     LL_PRINT("\n");
     LL_PRINT("YAML File Format:\n");
     LL_PRINT("\n");
@@ -143,11 +151,46 @@ static void options_show(const char *prgm)
     LL_PRINT("                                  : and palette pointers. Default is \'true\'\n");
     LL_PRINT("                                  : Optional parameter.\n");
     LL_PRINT("\n");
-    LL_PRINT("        compress: zx7             : Compress AppVar data using zx7.\n");
+    LL_PRINT("        compress: <mode>          : Compress AppVar data. mode can be \'zx7\',\n");
+    LL_PRINT("                                  : \'zx0\' (smaller, slower to decompress),\n");
+    LL_PRINT("                                  : or \'lz4\' (raw LZ4 block, larger but\n");
+    LL_PRINT("                                  : fastest to decompress).\n");
+    LL_PRINT("                                  : \'auto\' tries each of them and keeps\n");
+    LL_PRINT("                                  : the fastest to decompress within 1/16\n");
+    LL_PRINT("                                  : of the smallest, or leaves the data\n");
+    LL_PRINT("                                  : uncompressed if that does not help.\n");
+    LL_PRINT("                                  : zx0 is tried with the zx7 offset window\n");
+    LL_PRINT("                                  : to keep large images fast; set \'zx0\'\n");
+    LL_PRINT("                                  : to use its full window.\n");
+    LL_PRINT("                                  : The chosen format is defined as\n");
+    LL_PRINT("                                  : <name>_appvar_compression, which is\n");
+    LL_PRINT("                                  : 0 if auto left the data uncompressed.\n");
     LL_PRINT("                                  : The AppVar then needs to be decompressed\n");
     LL_PRINT("                                  : to access image and palette data.\n");
     LL_PRINT("                                  : Optional parameter.\n");
     LL_PRINT("\n");
+    LL_PRINT("        compress-level: <level>   : Use \'fast\' for quicker compression\n");
+    LL_PRINT("                                  : with larger output, or \'optimal\' for\n");
+    LL_PRINT("                                  : the smallest output.\n");
+    LL_PRINT("                                  : Default is \'optimal\'.\n");
+    LL_PRINT("                                  : Optional parameter.\n");
+    LL_PRINT("\n");
+    LL_PRINT("        compress-groups: <bool>   : \'true\' compresses the images of each\n");
+    LL_PRINT("                                  : convert together as one entry using\n");
+    LL_PRINT("                                  : the compress mode, instead of the\n");
+    LL_PRINT("                                  : whole AppVar. Similar images such as\n");
+    LL_PRINT("                                  : animation frames then share matches.\n");
+    LL_PRINT("                                  : Defines <convert>_group_compressed,\n");
+    LL_PRINT("                                  : <convert>_group_size, and the entry\n");
+    LL_PRINT("                                  : points <convert>_group_offsets and\n");
+    LL_PRINT("                                  : <image>_offset into the decompressed\n");
+    LL_PRINT("                                  : group. Tilesets are not grouped; their\n");
+    LL_PRINT("                                  : tiles are compressed one by one with\n");
+    LL_PRINT("                                  : the compress mode instead. The converts\n");
+    LL_PRINT("                                  : must not compress their images.\n");
+    LL_PRINT("                                  : Default is \'false\'.\n");
+    LL_PRINT("                                  : Optional parameter.\n");
+    LL_PRINT("\n");
     LL_PRINT("        archived: <bool>          : \'true\' makes the AppVar archived, while\n");
     LL_PRINT("                                  : \'false\' leaves it unarchived.\n");
     LL_PRINT("                                  : Optional parameter.\n");
@@ -229,6 +272,18 @@ static void options_show(const char *prgm)
     LL_PRINT("                                  : of 8 pixels. Tile numbers are determined\n");
     LL_PRINT("                                  : starting from the top left, moving right\n");
     LL_PRINT("                                  : to the bottom-right.\n");
+    LL_PRINT("                                  : Add \'dedupe:true\' to store identical\n");
+    LL_PRINT("                                  : tiles only once. The tile pointer table\n");
+    LL_PRINT("                                  : still has an entry for every tile, and a\n");
+    LL_PRINT("                                  : <name>_tile_map table maps each tile\n");
+    LL_PRINT("                                  : number to its stored tile.\n");
+    LL_PRINT("                                  : With \'dedupe:flip\', flipped copies are\n");
+    LL_PRINT("                                  : also merged, or with \'dedupe:rotate\'\n");
+    LL_PRINT("                                  : rotated copies too (square tiles only).\n");
+    LL_PRINT("                                  : <name>_tile_transforms then holds the\n");
+    LL_PRINT("                                  : flags to apply to each stored tile:\n");
+    LL_PRINT("                                  : bit 2 transposes (applied first), bit 0\n");
+    LL_PRINT("                                  : flips x, and bit 1 flips y.\n");
     LL_PRINT("\n");
     LL_PRINT("       transparent-color-index:   : Transparent color index in the palette\n");
     LL_PRINT("                                  : (probably determined using fixed-color),\n");
@@ -251,10 +306,26 @@ static void options_show(const char *prgm)
     LL_PRINT("                                  : the output size if there are many\n");
     LL_PRINT("                                  : transparent pixels.\n");
     LL_PRINT("\n");
-    LL_PRINT("      compress: zx7               : After quantization, images can then\n");
-    LL_PRINT("                                  : optionally be compressed in zx7 format.\n");
+    LL_PRINT("      compress: <mode>            : After quantization, images can then\n");
+    LL_PRINT("                                  : optionally be compressed. mode can be\n");
+    LL_PRINT("                                  : \'zx7\', \'zx0\' (smaller, slower to\n");
+    LL_PRINT("                                  : decompress), or \'lz4\' (raw LZ4 block,\n");
+    LL_PRINT("                                  : larger but fastest to decompress).\n");
+    LL_PRINT("                                  : \'auto\' picks per image and tile like\n");
+    LL_PRINT("                                  : the AppVar option does.\n");
     LL_PRINT("                                  : The images will then be required to be\n");
     LL_PRINT("                                  : decompressed before use.\n");
+    LL_PRINT("                                  : Compressed data defines <name>_compression\n");
+    LL_PRINT("                                  : as 1 (zx7), 2 (zx0), or 3 (lz4). A value\n");
+    LL_PRINT("                                  : of 4 means tiles differ; each stored\n");
+    LL_PRINT("                                  : tile is listed in <name>_tile_compression\n");
+    LL_PRINT("                                  : where 0 means uncompressed. With \'auto\'\n");
+    LL_PRINT("                                  : raw data defines <name>_compression as 0.\n");
+    LL_PRINT("\n");
+    LL_PRINT("      compress-level: <level>     : Use \'fast\' for quicker compression,\n");
+    LL_PRINT("                                  : useful while iterating; output is\n");
+    LL_PRINT("                                  : larger but decompresses the same way.\n");
+    LL_PRINT("                                  : Default is \'optimal\'.\n");
     LL_PRINT("\n");
     LL_PRINT("      width-and-height: <bool>    : Optionally control if the width and\n");
     LL_PRINT("                                  : height should be placed in the converted\n");
@@ -264,6 +335,8 @@ static void options_show(const char *prgm)
     LL_PRINT("                                  : This also affects the size of the\n");
     LL_PRINT("                                  : generated palette; use with caution.\n");
     LL_PRINT("                                  : Available options are 1,2,4,8.\n");
+    LL_PRINT("                                  : The first pixel is stored in the high\n");
+    LL_PRINT("                                  : bits, and rows are padded to a byte.\n");
     LL_PRINT("                                  : The default is 8.\n");
     LL_PRINT("\n");
     LL_PRINT("      omit-palette-index: <index> : Omits the specified palette index\n");
@@ -272,6 +345,17 @@ static void options_show(const char *prgm)
     LL_PRINT("                                  : can be specified multiple times for\n");
     LL_PRINT("                                  : multiple excluded indices. \n");
     LL_PRINT("\n");
+    LL_PRINT("      remap: <method>             : Method used to map image colors to the\n");
+    LL_PRINT("                                  : palette. \'liq\' quantizes each image\n");
+    LL_PRINT("                                  : with libimagequant. \'direct\' builds a\n");
+    LL_PRINT("                                  : nearest color table once per palette,\n");
+    LL_PRINT("                                  : which is much faster for many images.\n");
+    LL_PRINT("                                  : The default is \'liq\'.\n");
+    LL_PRINT("\n");
+    LL_PRINT("      dither: <bool>              : Controls if dithering is applied when\n");
+    LL_PRINT("                                  : mapping colors to the palette.\n");
+    LL_PRINT("                                  : The default is \'true\'.\n");
+    LL_PRINT("\n");
     LL_PRINT("----------------------------------------------------------------------------\n");
     LL_PRINT("\n");
     LL_PRINT("Credits:\n");
@@ -406,14 +490,17 @@ int options_get(int argc, char *argv[], options_t *options)
             {"icon-output",      required_argument, 0, 0},
             {"icon-description", required_argument, 0, 0},
             {"icon-format",      required_argument, 0, 0},
+            {"image-cache",      required_argument, 0, 0},
+            {"cache-dir",        required_argument, 0, 0},
             {"new",              no_argument,       0, 'n'},
             {"input",            required_argument, 0, 'i'},
             {"help",             no_argument,       0, 'h'},
             {"version",          no_argument,       0, 'v'},
             {"log-level",        required_argument, 0, 'l'},
+            {"threads",          required_argument, 0, 'j'},
             {0, 0, 0, 0}
         };
-        int c = getopt_long(argc, argv, "i:l:nhv", long_options, &optidx);
+        int c = getopt_long(argc, argv, "i:l:j:nhv", long_options, &optidx);
 
         if (c == - 1)
         {
@@ -423,22 +510,25 @@ int options_get(int argc, char *argv[], options_t *options)
         switch (c)
         {
             case 0:
-                options->convertIcon = true;
                 switch (optidx)
                 {
                     case 0:
+                        options->convertIcon = true;
                         options->icon.imageFile = optarg;
                         break;
 
                     case 1:
+                        options->convertIcon = true;
                         options->icon.outputFile = optarg;
                         break;
 
                     case 2:
+                        options->convertIcon = true;
                         options->icon.description = optarg;
                         break;
 
                     case 3:
+                        options->convertIcon = true;
                         if (optarg != NULL)
                         {
                             if (!strcmp(optarg, "asm"))
@@ -452,6 +542,14 @@ int options_get(int argc, char *argv[], options_t *options)
                         }
                         break;
 
+                    case 4:
+                        image_cache_set_size((int)strtol(optarg, NULL, 0));
+                        break;
+
+                    case 5:
+                        cache_set_dir(optarg);
+                        break;
+
                     default:
                         break;
                 }
@@ -473,6 +571,10 @@ int options_get(int argc, char *argv[], options_t *options)
                 log_set_level((log_level_t)strtol(optarg, NULL, 0));
                 break;
 
+            case 'j':
+                thread_set_count((int)strtol(optarg, NULL, 0));
+                break;
+
             case 'h':
                 options_show(options->prgm);
                 return OPTIONS_IGNORE;
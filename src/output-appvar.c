@@ -29,10 +29,12 @@
  */
 
 #include "output.h"
+#include "output-formats.h"
 #include "appvar.h"
 #include "strings.h"
 #include "log.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
@@ -53,16 +55,177 @@ int output_appvar_image(image_t *image, appvar_t *appvar)
     return 0;
 }
 
+/*
+ * Compresses a copy of a tileset per tile for the AppVar to store,
+ * leaving the converted tileset untouched for other outputs.
+ */
+static int output_appvar_copy_tileset(appvar_t *appvar, const tileset_t *tileset)
+{
+    appvar_tileset_t *tilesets;
+    tileset_t *copy;
+    int i;
+
+    tilesets = realloc(appvar->tilesets,
+        (appvar->numTilesets + 1) * sizeof(appvar_tileset_t));
+    if (tilesets == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    appvar->tilesets = tilesets;
+    copy = &tilesets[appvar->numTilesets].copy;
+    *copy = *tileset;
+    copy->slab = NULL;
+    copy->compressAuto = appvar->compress == COMPRESS_AUTO;
+    copy->tiles = malloc((tileset->numUniqueTiles + 1) * sizeof(tileset_tile_t));
+    if (copy->tiles == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    for (i = 0; i < tileset->numUniqueTiles; ++i)
+    {
+        copy->tiles[i] = tileset->tiles[i];
+    }
+
+    tilesets[appvar->numTilesets].source = tileset;
+    appvar->numTilesets++;
+
+    return convert_compress_tileset(copy, appvar->compress, appvar->compressLevel);
+}
+
+/*
+ * Gets a tileset as the AppVar stores it, which is either the converted
+ * tileset or a compressed copy of it.
+ */
+static const tileset_t *output_appvar_stored_tileset(const appvar_t *appvar, const tileset_t *tileset)
+{
+    int i;
+
+    for (i = 0; i < appvar->numTilesets; ++i)
+    {
+        if (appvar->tilesets[i].source == tileset)
+        {
+            return &appvar->tilesets[i].copy;
+        }
+    }
+
+    return tileset;
+}
+
+/*
+ * Outputs the images of a convert as a single compressed AppVar entry,
+ * so that similar images such as animation frames share matches.
+ * Tilesets stay separate and the AppVar stores copies of them compressed
+ * per tile with the same mode, unless the convert already compressed them.
+ */
+int output_appvar_group(convert_t *convert, appvar_t *appvar)
+{
+    compress_t compress = appvar->compress;
+    unsigned char *data;
+    size_t size = 0;
+    int ret;
+    int i, j;
+
+    convert->groupSize = 0;
+    convert->groupCompress = COMPRESS_NONE;
+
+    if (compress != COMPRESS_NONE && convert->compress == COMPRESS_NONE)
+    {
+        for (i = 0; i < convert->numTilesetGroups; ++i)
+        {
+            tileset_group_t *tilesetGroup = convert->tilesetGroups[i];
+
+            for (j = 0; j < tilesetGroup->numTilesets; ++j)
+            {
+                tileset_t *tileset = &tilesetGroup->tilesets[j];
+
+                ret = output_appvar_copy_tileset(appvar, tileset);
+                if (ret != 0)
+                {
+                    LL_ERROR("Failed to compress tileset '%s'.",
+                        tileset->image.name);
+                    return ret;
+                }
+            }
+        }
+    }
+
+    if (convert->numImages == 0)
+    {
+        return 0;
+    }
+
+    if (compress != COMPRESS_NONE && convert->compress != COMPRESS_NONE)
+    {
+        LL_ERROR("Convert \'%s\' cannot compress images when AppVar \'%s\' "
+                 "compresses groups.", convert->name, appvar->name);
+        return 1;
+    }
+
+    for (i = 0; i < convert->numImages; ++i)
+    {
+        size += convert->images[i].size;
+    }
+
+    data = malloc(size + 1);
+    if (data == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    size = 0;
+    for (i = 0; i < convert->numImages; ++i)
+    {
+        memcpy(data + size, convert->images[i].data, convert->images[i].size);
+        size += convert->images[i].size;
+    }
+
+    ret = compress_array(&data, &size, &compress, appvar->compressLevel);
+    if (ret == 0)
+    {
+        if (appvar->size + size >= APPVAR_MAX_DATA_SIZE)
+        {
+            LL_ERROR("Too much data for AppVar \'%s\'.", appvar->name);
+            ret = 1;
+        }
+        else
+        {
+            memcpy(&appvar->data[appvar->size], data, size);
+            appvar->size += size;
+            convert->groupSize = size;
+            convert->groupCompress = compress;
+        }
+    }
+
+    free(data);
+
+    return ret;
+}
+
+/*
+ * Checks if the images of a convert are stored as one compressed entry.
+ * A group left uncompressed is laid out like separate images.
+ */
+static bool output_appvar_is_group(const appvar_t *appvar, const convert_t *convert)
+{
+    return appvar->compressGroups && convert->groupCompress != COMPRESS_NONE;
+}
+
 /*
  * Outputs a converted AppVar tileset.
  */
 int output_appvar_tileset(tileset_t *tileset, appvar_t *appvar)
 {
+    const tileset_t *stored = output_appvar_stored_tileset(appvar, tileset);
     int i;
 
-    for (i = 0; i < tileset->numTiles; ++i)
+    for (i = 0; i < stored->numUniqueTiles; ++i)
     {
-        tileset_tile_t *tile = &tileset->tiles[i];
+        const tileset_tile_t *tile = &stored->tiles[i];
 
         if (appvar->size + tile->size >= APPVAR_MAX_DATA_SIZE)
         {
@@ -141,6 +304,46 @@ void output_appvar_c_include_file(output_t *output, FILE *fdh)
     for (i = 0; i < output->numConverts; ++i)
     {
         convert_t *convert = output->converts[i];
+        bool group = output_appvar_is_group(appvar, convert);
+        int offset = 0;
+
+        if (group)
+        {
+            for (j = 0; j < convert->numImages; ++j)
+            {
+                offset += convert->images[j].size;
+            }
+
+            fprintf(fdh, "#define %s_group_compression %d /* %s */\n",
+                convert->name,
+                convert->groupCompress,
+                compress_name(convert->groupCompress));
+            fprintf(fdh, "#define %s_group_compressed %s_appvar[%d]\n",
+                convert->name,
+                appvar->name,
+                index);
+            fprintf(fdh, "#define %s_group_size %d\n",
+                convert->name,
+                offset);
+            fprintf(fdh, "#define %s_group_num %d\n",
+                convert->name,
+                convert->numImages);
+            fprintf(fdh, "extern unsigned int %s_group_offsets[%d];\n",
+                convert->name,
+                convert->numImages);
+
+            offset = 0;
+            index++;
+        }
+        else if (appvar->compressGroups &&
+                 appvar->compress == COMPRESS_AUTO &&
+                 convert->numImages > 0)
+        {
+            fprintf(fdh, "#define %s_group_compression %d /* %s */\n",
+                convert->name,
+                COMPRESS_NONE,
+                compress_name(COMPRESS_NONE));
+        }
 
         for (j = 0; j < convert->numImages; ++j)
         {
@@ -153,6 +356,25 @@ void output_appvar_c_include_file(output_t *output, FILE *fdh)
                 image->name,
                 image->height);
 
+            /* grouped images are found at an offset once decompressed */
+            if (group)
+            {
+                fprintf(fdh, "#define %s_offset %d\n",
+                    image->name,
+                    offset);
+
+                offset += image->size;
+                continue;
+            }
+
+            if (image->compressed || image->compressAuto)
+            {
+                fprintf(fdh, "#define %s_compression %d /* %s */\n",
+                    image->name,
+                    image->compress,
+                    compress_name(image->compress));
+            }
+
             if (image->compressed)
             {
                 fprintf(fdh, "#define %s_compressed %s_appvar[%d]\n",
@@ -178,6 +400,8 @@ void output_appvar_c_include_file(output_t *output, FILE *fdh)
             for (k = 0; k < tilesetGroup->numTilesets; ++k)
             {
                 tileset_t *tileset = &tilesetGroup->tilesets[k];
+                const tileset_t *stored = output_appvar_stored_tileset(appvar, tileset);
+                compress_t compress = tileset_compress(stored);
 
                 tileset->appvarIndex = index;
 
@@ -188,8 +412,22 @@ void output_appvar_c_include_file(output_t *output, FILE *fdh)
                     tileset->image.name,
                     tileset->tileHeight);
 
-                if (tileset->compressed)
+                if (stored->compressed || stored->compressAuto)
                 {
+                    fprintf(fdh, "#define %s_compression %d /* %s */\n",
+                        tileset->image.name,
+                        compress,
+                        compress_name(compress));
+                }
+
+                if (stored->compressed)
+                {
+                    if (compress == COMPRESS_AUTO)
+                    {
+                        fprintf(fdh, "extern unsigned char %s_tile_compression[%d];\n",
+                            tileset->image.name,
+                            tileset->numUniqueTiles);
+                    }
                     fprintf(fdh, "#define %s_compressed %s_appvar[%d]\n",
                         tileset->image.name,
                         appvar->name,
@@ -234,6 +472,25 @@ void output_appvar_c_include_file(output_t *output, FILE *fdh)
                     }
                 }
 
+                if (tileset->dedupe != TILESET_DEDUPE_NONE)
+                {
+                    fprintf(fdh, "#define %s_unique_tiles_num %d\n",
+                        tileset->image.name,
+                        tileset->numUniqueTiles);
+                    fprintf(fdh, "extern %s %s_tile_map[%d];\n",
+                        tileset_map_entry_size(tileset) == 1 ?
+                            "unsigned char" : "unsigned short",
+                        tileset->image.name,
+                        tileset->numTiles);
+                }
+
+                if (tileset_has_transforms(tileset))
+                {
+                    fprintf(fdh, "extern unsigned char %s_tile_transforms[%d];\n",
+                        tileset->image.name,
+                        tileset->numTiles);
+                }
+
                 index++;
             }
         }
@@ -245,9 +502,17 @@ void output_appvar_c_include_file(output_t *output, FILE *fdh)
         appvar->name,
         appvar->numEntries);
 
+    if (appvar_is_compressed(appvar) || appvar->compressAuto)
+    {
+        fprintf(fdh, "#define %s_appvar_compression %d /* %s */\r\n",
+            appvar->name,
+            appvar->compress,
+            compress_name(appvar->compress));
+    }
+
     if (appvar->init)
     {
-        if (appvar->compress != COMPRESS_NONE)
+        if (appvar_is_compressed(appvar))
         {
             fprintf(fdh, "unsigned char %s_init(void *addr);\r\n",
                 appvar->name);
@@ -267,10 +532,38 @@ void output_appvar_c_include_file(output_t *output, FILE *fdh)
     fprintf(fdh, "#endif\r\n");
 }
 
+/*
+ * Outputs a byte table to a C style source file.
+ */
+static int output_appvar_c_bytes(FILE *fds, const uint8_t *arr, size_t size)
+{
+    static const output_hex_format_t format =
+    {
+        .prefix = "0x",
+        .separator = ",",
+        .lineBreak = ",\r\n    ",
+        .bytesPerLine = 32,
+        .upper = false,
+    };
+    int ret;
+
+    if (size != 0)
+    {
+        fputs("    ", fds);
+    }
+
+    ret = output_hex(fds, arr, size, &format);
+
+    fputs("\r\n};\r\n\r\n", fds);
+
+    return ret;
+}
+
 /*
  * Outputs a C style source file.
+ * Returns 0 on success.
  */
-void output_appvar_c_source_file(output_t *output, FILE *fds)
+int output_appvar_c_source_file(output_t *output, FILE *fds)
 {
     appvar_t *appvar = &output->appvar;
     int offset = 0;
@@ -298,12 +591,22 @@ void output_appvar_c_source_file(output_t *output, FILE *fds)
     {
         convert_t *convert = output->converts[i];
 
-        for (j = 0; j < convert->numImages; ++j)
+        if (output_appvar_is_group(appvar, convert))
         {
             fprintf(fds, "    (unsigned char*)%d,\r\n",
                 offset);
 
-            offset += convert->images[j].size;
+            offset += convert->groupSize;
+        }
+        else
+        {
+            for (j = 0; j < convert->numImages; ++j)
+            {
+                fprintf(fds, "    (unsigned char*)%d,\r\n",
+                    offset);
+
+                offset += convert->images[j].size;
+            }
         }
 
         for (j = 0; j < convert->numTilesetGroups; ++j)
@@ -312,10 +615,11 @@ void output_appvar_c_source_file(output_t *output, FILE *fds)
 
             for (k = 0; k < tilesetGroup->numTilesets; ++k)
             {
-                tileset_t *tileset = &tilesetGroup->tilesets[k];
+                const tileset_t *tileset =
+                    output_appvar_stored_tileset(appvar, &tilesetGroup->tilesets[k]);
                 int tilesetOffset = 0;
 
-                for (l = 0; l < tileset->numTiles; l++)
+                for (l = 0; l < tileset->numUniqueTiles; l++)
                 {
                     tilesetOffset += tileset->tiles[l].size;
                 }
@@ -330,6 +634,32 @@ void output_appvar_c_source_file(output_t *output, FILE *fds)
 
     fprintf(fds, "};\r\n\r\n");
 
+    /* output entry points of grouped images */
+    for (i = 0; i < output->numConverts; ++i)
+    {
+        convert_t *convert = output->converts[i];
+        int groupOffset = 0;
+
+        if (!output_appvar_is_group(appvar, convert))
+        {
+            continue;
+        }
+
+        fprintf(fds, "unsigned int %s_group_offsets[%d] =\r\n{\r\n",
+            convert->name,
+            convert->numImages);
+
+        for (j = 0; j < convert->numImages; ++j)
+        {
+            fprintf(fds, "    %d,\r\n",
+                groupOffset);
+
+            groupOffset += convert->images[j].size;
+        }
+
+        fprintf(fds, "};\r\n\r\n");
+    }
+
     /* output tilemap tables */
     for (i = 0; i < output->numConverts; ++i)
     {
@@ -341,8 +671,10 @@ void output_appvar_c_source_file(output_t *output, FILE *fds)
 
             for (k = 0; k < tilesetGroup->numTilesets; ++k)
             {
-                tileset_t *tileset = &tilesetGroup->tilesets[k];
+                const tileset_t *tileset =
+                    output_appvar_stored_tileset(appvar, &tilesetGroup->tilesets[k]);
                 int tilesetOffset = 0;
+                int *tileOffsets;
 
                 if (tileset->compressed)
                 {
@@ -357,22 +689,101 @@ void output_appvar_c_source_file(output_t *output, FILE *fds)
                         tileset->numTiles);
                 }
 
-                for (l = 0; l < tileset->numTiles; l++)
+                tileOffsets = malloc((tileset->numUniqueTiles + 1) * sizeof(int));
+                if (tileOffsets == NULL)
                 {
-                    fprintf(fds, "    (unsigned char*)%d,\r\n",
-                        tilesetOffset);
+                    LL_ERROR("Memory error in %s", __func__);
+                    return 1;
+                }
 
+                for (l = 0; l < tileset->numUniqueTiles; l++)
+                {
+                    tileOffsets[l] = tilesetOffset;
                     tilesetOffset += tileset->tiles[l].size;
                 }
 
+                for (l = 0; l < tileset->numTiles; l++)
+                {
+                    fprintf(fds, "    (unsigned char*)%d,\r\n",
+                        tileOffsets[tileset->tileMap[l]]);
+                }
+
                 fprintf(fds, "};\r\n\r\n");
+
+                free(tileOffsets);
+
+                if (tileset->dedupe != TILESET_DEDUPE_NONE)
+                {
+                    fprintf(fds, "%s %s_tile_map[%d] =\r\n{\r\n",
+                        tileset_map_entry_size(tileset) == 1 ?
+                            "unsigned char" : "unsigned short",
+                        tileset->image.name,
+                        tileset->numTiles);
+
+                    if (tileset_map_entry_size(tileset) == 2)
+                    {
+                        for (l = 0; l < tileset->numTiles; l++)
+                        {
+                            fprintf(fds, "    %d,\r\n",
+                                tileset->tileMap[l]);
+                        }
+
+                        fprintf(fds, "};\r\n\r\n");
+                    }
+                    else
+                    {
+                        uint8_t *table;
+                        size_t size;
+
+                        table = tileset_map_table(tileset, &size);
+                        if (table == NULL)
+                        {
+                            LL_ERROR("Memory error in %s", __func__);
+                            return 1;
+                        }
+
+                        output_appvar_c_bytes(fds, table, size);
+
+                        free(table);
+                    }
+                }
+
+                if (tileset_has_transforms(tileset))
+                {
+                    fprintf(fds, "unsigned char %s_tile_transforms[%d] =\r\n{\r\n",
+                        tileset->image.name,
+                        tileset->numTiles);
+
+                    output_appvar_c_bytes(fds, tileset->tileFlags, tileset->numTiles);
+                }
+
+                if (tileset->compressed &&
+                    tileset_compress(tileset) == COMPRESS_AUTO)
+                {
+                    uint8_t *table;
+
+                    table = tileset_compress_table(tileset);
+                    if (table == NULL)
+                    {
+                        LL_ERROR("Memory error in %s", __func__);
+                        return 1;
+                    }
+
+                    fprintf(fds, "unsigned char %s_tile_compression[%d] =\r\n{\r\n",
+                        tileset->image.name,
+                        tileset->numUniqueTiles);
+
+                    output_appvar_c_bytes(fds, table, tileset->numUniqueTiles);
+
+                    free(table);
+                }
             }
         }
     }
 
     if (appvar->init)
     {
-        if (appvar->compress != COMPRESS_NONE)
+        if (appvar_is_compressed(appvar))
         {
             fprintf(fds, "unsigned char %s_init(void *addr)\r\n", appvar->name);
             fprintf(fds, "{\r\n");
@@ -416,7 +827,7 @@ void output_appvar_c_source_file(output_t *output, FILE *fds)
                 {
                     tileset_t *tileset = &tilesetGroup->tilesets[k];
 
-                    if (tileset->compressed)
+                    if (output_appvar_stored_tileset(appvar, tileset)->compressed)
                     {
                         fprintf(fds, "    data = (unsigned int)%s_appvar[%u] - (unsigned int)%s_tiles_compressed[0];\r\n",
                             appvar->name,
@@ -449,6 +860,8 @@ void output_appvar_c_source_file(output_t *output, FILE *fds)
         fprintf(fds, "    return 1;\r\n");
         fprintf(fds, "};\r\n\r\n");
     }
+
+    return 0;
 }
 
 /*
@@ -481,6 +894,12 @@ int output_appvar_include_file(output_t *output, appvar_t *appvar)
         goto error;
     }
 
+    /* compress first so the headers describe the stored format */
+    if (appvar_compress(appvar) != 0)
+    {
+        goto error;
+    }
+
     switch (appvar->source)
     {
         case APPVAR_SOURCE_C:
@@ -505,7 +924,13 @@ int output_appvar_include_file(output_t *output, appvar_t *appvar)
                 goto error;
             }
 
-            output_appvar_c_source_file(output, fds);
+            if (output_appvar_c_source_file(output, fds) != 0)
+            {
+                fclose(fdh);
+                fclose(fds);
+                remove(varCName);
+                goto error;
+            }
 
             fclose(fdh);
             fclose(fds);
@@ -29,6 +29,7 @@
  */
 
 #include "output.h"
+#include "output-formats.h"
 #include "tileset.h"
 #include "strings.h"
 #include "image.h"
@@ -44,28 +45,21 @@
  */
 static int output_asm(unsigned char *arr, size_t size, FILE *fdo)
 {
-    size_t i;
-
-    for (i = 0; i < size; ++i)
+    static const output_hex_format_t format =
     {
-        bool last = i + 1 == size;
+        .prefix = "$",
+        .separator = ",",
+        .lineBreak = "\r\n\tdb\t",
+        .bytesPerLine = 32,
+        .upper = false,
+    };
+    int ret;
+
+    ret = output_hex(fdo, arr, size, &format);
 
-        if (last || ((i + 1) % 32 == 0))
-        {
-            fprintf(fdo, "$%02x", arr[i]);
-            if (!last)
-            {
-                fputs("\r\n\tdb\t", fdo);
-            }
-        }
-        else
-        {
-             fprintf(fdo, "$%02x,", arr[i]);
-        }
-    }
     fputs("\r\n", fdo);
 
-    return 0;
+    return ret;
 }
 
 /*
@@ -88,6 +82,13 @@ int output_asm_image(image_t *image)
     fprintf(fds, "%s_width := %d\r\n", image->name, image->width);
     fprintf(fds, "%s_height := %d\r\n", image->name, image->height);
     fprintf(fds, "%s_size := %d\r\n", image->name, image->size);
+    if (image->compressed || image->compressAuto)
+    {
+        fprintf(fds, "%s_compression := %d ; %s\r\n",
+            image->name,
+            image->compress,
+            compress_name(image->compress));
+    }
     fprintf(fds, "%s:\r\n\tdb\t", image->name);
 
     output_asm(image->data, image->size, fds);
@@ -109,6 +110,7 @@ error:
 int output_asm_tileset(tileset_t *tileset)
 {
     char *source = strdupcat(tileset->directory, ".asm");
+    compress_t compress = tileset_compress(tileset);
     FILE *fds;
     int i;
 
@@ -125,7 +127,22 @@ int output_asm_tileset(tileset_t *tileset)
         tileset->image.name,
         tileset->numTiles);
 
-    for (i = 0; i < tileset->numTiles; ++i)
+    if (tileset->dedupe != TILESET_DEDUPE_NONE)
+    {
+        fprintf(fds, "%s_num_unique_tiles := %d\r\n",
+            tileset->image.name,
+            tileset->numUniqueTiles);
+    }
+
+    if (tileset->compressed || tileset->compressAuto)
+    {
+        fprintf(fds, "%s_compression := %d ; %s\r\n",
+            tileset->image.name,
+            compress,
+            compress_name(compress));
+    }
+
+    for (i = 0; i < tileset->numUniqueTiles; ++i)
     {
         tileset_tile_t *tile = &tileset->tiles[i];
 
@@ -143,10 +160,58 @@ int output_asm_tileset(tileset_t *tileset)
         {
             fprintf(fds, "\tdl\t%s_tile_%d\r\n",
                 tileset->image.name,
-                i);
+                tileset->tileMap[i]);
+        }
+    }
+
+    if (tileset->dedupe != TILESET_DEDUPE_NONE)
+    {
+        uint8_t *table;
+        size_t size;
+
+        table = tileset_map_table(tileset, &size);
+        if (table == NULL)
+        {
+            LL_ERROR("Memory error in %s", __func__);
+            fclose(fds);
+            goto error;
         }
+
+        fprintf(fds, "%s_tile_map:\r\n\tdb\t", tileset->image.name);
+
+        output_asm(table, size, fds);
+
+        free(table);
     }
 
+    if (tileset_has_transforms(tileset))
+    {
+        fprintf(fds, "%s_tile_transforms:\r\n\tdb\t", tileset->image.name);
+
+        output_asm(tileset->tileFlags, tileset->numTiles, fds);
+    }
+
+    if (tileset->compressed && compress == COMPRESS_AUTO)
+    {
+        uint8_t *table;
+
+        table = tileset_compress_table(tileset);
+        if (table == NULL)
+        {
+            LL_ERROR("Memory error in %s", __func__);
+            fclose(fds);
+            goto error;
+        }
+
+        fprintf(fds, "%s_tile_compression:\r\n\tdb\t", tileset->image.name);
+
+        output_asm(table, tileset->numUniqueTiles, fds);
+
+        free(table);
+    }
+
+    fclose(fds);
+
     free(source);
 
     return 0;
@@ -101,22 +101,67 @@ int output_bin_tileset(tileset_t *tileset)
     if (tileset->pTable == true)
     {
         int offset = tileset->numTiles * 3;
+        int *tileOffsets;
+
+        if (tileset->dedupe != TILESET_DEDUPE_NONE)
+        {
+            offset += tileset->numTiles * tileset_map_entry_size(tileset);
+        }
+
+        if (tileset_has_transforms(tileset))
+        {
+            offset += tileset->numTiles;
+        }
+
+        tileOffsets = malloc(tileset->numUniqueTiles * sizeof(int));
+        if (tileOffsets == NULL)
+        {
+            LL_DEBUG("Memory error in %s", __func__);
+            fclose(fds);
+            goto error;
+        }
+
+        for (i = 0; i < tileset->numUniqueTiles; ++i)
+        {
+            tileOffsets[i] = offset;
+            offset += tileset->tiles[i].size;
+        }
 
         for (i = 0; i < tileset->numTiles; ++i)
         {
             unsigned char tileOffset[3];
 
+            offset = tileOffsets[tileset->tileMap[i]];
+
             tileOffset[0] = offset & 255;
             tileOffset[1] = (offset >> 8) & 255;
             tileOffset[2] = (offset >> 16) & 255;
 
             output_bin(tileOffset, sizeof tileOffset, fds);
+        }
 
-            offset += tileset->tiles[i].size;
+        free(tileOffsets);
+    }
+
+    if (tileset->dedupe != TILESET_DEDUPE_NONE)
+    {
+        for (i = 0; i < tileset->numTiles; ++i)
+        {
+            unsigned char entry[2];
+
+            entry[0] = tileset->tileMap[i] & 255;
+            entry[1] = (tileset->tileMap[i] >> 8) & 255;
+
+            output_bin(entry, tileset_map_entry_size(tileset), fds);
         }
     }
 
-    for (i = 0; i < tileset->numTiles; ++i)
+    if (tileset_has_transforms(tileset))
+    {
+        output_bin(tileset->tileFlags, tileset->numTiles, fds);
+    }
+
+    for (i = 0; i < tileset->numUniqueTiles; ++i)
     {
         tileset_tile_t *tile = &tileset->tiles[i];
 
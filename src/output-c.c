@@ -29,6 +29,7 @@
  */
 
 #include "output.h"
+#include "output-formats.h"
 #include "tileset.h"
 #include "strings.h"
 #include "image.h"
@@ -44,27 +45,26 @@
  */
 static int output_c(unsigned char *arr, size_t size, FILE *fdo)
 {
-    size_t i;
-
-    for (i = 0; i < size; ++i)
+    static const output_hex_format_t format =
     {
-        if (i % 32 == 0)
-        {
-            fputs("\r\n    ", fdo);
-        }
-
-        if (i + 1 == size)
-        {
-            fprintf(fdo, "0x%02x", arr[i]);
-        }
-        else
-        {
-            fprintf(fdo, "0x%02x,", arr[i]);
-        }
+        .prefix = "0x",
+        .separator = ",",
+        .lineBreak = ",\r\n    ",
+        .bytesPerLine = 32,
+        .upper = false,
+    };
+    int ret;
+
+    if (size != 0)
+    {
+        fputs("\r\n    ", fdo);
     }
-    fprintf(fdo, "\r\n};\r\n");
 
-    return 0;
+    ret = output_hex(fdo, arr, size, &format);
+
+    fputs("\r\n};\r\n", fdo);
+
+    return ret;
 }
 
 /*
@@ -97,6 +97,15 @@ int output_c_image(image_t *image)
     fprintf(fdh, "#define %s_height %d\r\n", image->name, image->height);
     fprintf(fdh, "#define %s_size %d\r\n", image->name, image->size);
 
+    /* auto records raw data as compression 0 */
+    if (image->compressed || image->compressAuto)
+    {
+        fprintf(fdh, "#define %s_compression %d /* %s */\r\n",
+            image->name,
+            image->compress,
+            compress_name(image->compress));
+    }
+
     if (image->compressed)
     {
         fprintf(fdh, "extern unsigned char %s_compressed[%d];\r\n", image->name, image->size);
@@ -157,6 +166,82 @@ error:
 }
 
 
+/*
+ * Gets the C type used for tile map entries.
+ */
+static const char *output_c_tile_map_type(tileset_t *tileset)
+{
+    return tileset_map_entry_size(tileset) == 1 ?
+        "unsigned char" : "unsigned short";
+}
+
+/*
+ * Outputs the map from tile numbers to stored tiles.
+ */
+static int output_c_tile_map(tileset_t *tileset, FILE *fds)
+{
+    uint8_t *table;
+    size_t size;
+    int i;
+
+    fprintf(fds, "%s %s_tile_map[%d] =\r\n{",
+        output_c_tile_map_type(tileset),
+        tileset->image.name,
+        tileset->numTiles);
+
+    if (tileset_map_entry_size(tileset) == 2)
+    {
+        for (i = 0; i < tileset->numTiles; ++i)
+        {
+            fprintf(fds, "%s%d",
+                i == 0 ? "\r\n    " : i % 32 == 0 ? ",\r\n    " : ",",
+                tileset->tileMap[i]);
+        }
+
+        fprintf(fds, "\r\n};\r\n");
+
+        return 0;
+    }
+
+    table = tileset_map_table(tileset, &size);
+    if (table == NULL)
+    {
+        LL_ERROR("Memory error in %s", __func__);
+        return 1;
+    }
+
+    output_c(table, size, fds);
+
+    free(table);
+
+    return 0;
+}
+
+/*
+ * Outputs the format of each stored tile, for mixed compressed tilesets.
+ */
+static int output_c_tile_compression(tileset_t *tileset, FILE *fds)
+{
+    uint8_t *table;
+
+    table = tileset_compress_table(tileset);
+    if (table == NULL)
+    {
+        LL_ERROR("Memory error in %s", __func__);
+        return 1;
+    }
+
+    fprintf(fds, "unsigned char %s_tile_compression[%d] =\r\n{",
+        tileset->image.name,
+        tileset->numUniqueTiles);
+
+    output_c(table, tileset->numUniqueTiles, fds);
+
+    free(table);
+
+    return 0;
+}
+
 /*
  * Outputs a converted C tileset.
  */
@@ -164,6 +249,7 @@ int output_c_tileset(tileset_t *tileset)
 {
     char *header = strdupcat(tileset->directory, ".h");
     char *source = strdupcat(tileset->directory, ".c");
+    compress_t compress = tileset_compress(tileset);
     FILE *fdh;
     FILE *fds;
     int i;
@@ -185,7 +271,7 @@ int output_c_tileset(tileset_t *tileset)
     fprintf(fdh, "#endif\r\n");
     fprintf(fdh, "\r\n");
 
-    for (i = 0; i < tileset->numTiles; ++i)
+    for (i = 0; i < tileset->numUniqueTiles; ++i)
     {
         tileset_tile_t *tile = &tileset->tiles[i];
 
@@ -214,6 +300,38 @@ int output_c_tileset(tileset_t *tileset)
         tileset->image.name,
         tileset->numTiles);
 
+    if (tileset->compressed || tileset->compressAuto)
+    {
+        fprintf(fdh, "#define %s_compression %d /* %s */\r\n",
+            tileset->image.name,
+            compress,
+            compress_name(compress));
+        if (compress == COMPRESS_AUTO)
+        {
+            fprintf(fdh, "extern unsigned char %s_tile_compression[%d];\r\n",
+                tileset->image.name,
+                tileset->numUniqueTiles);
+        }
+    }
+
+    if (tileset->dedupe != TILESET_DEDUPE_NONE)
+    {
+        fprintf(fdh, "#define %s_num_unique_tiles %d\r\n",
+            tileset->image.name,
+            tileset->numUniqueTiles);
+        fprintf(fdh, "extern %s %s_tile_map[%d];\r\n",
+            output_c_tile_map_type(tileset),
+            tileset->image.name,
+            tileset->numTiles);
+    }
+
+    if (tileset_has_transforms(tileset))
+    {
+        fprintf(fdh, "extern unsigned char %s_tile_transforms[%d];\r\n",
+            tileset->image.name,
+            tileset->numTiles);
+    }
+
     if (tileset->pTable)
     {
         if (tileset->compressed)
@@ -252,7 +370,7 @@ int output_c_tileset(tileset_t *tileset)
         goto error;
     }
 
-    for (i = 0; i < tileset->numTiles; ++i)
+    for (i = 0; i < tileset->numUniqueTiles; ++i)
     {
         tileset_tile_t *tile = &tileset->tiles[i];
 
@@ -295,19 +413,46 @@ int output_c_tileset(tileset_t *tileset)
             {
                 fprintf(fds, "    %s_tile_%d_compressed,\r\n",
                     tileset->image.name,
-                    i);
+                    tileset->tileMap[i]);
             }
             else
             {
                 fprintf(fds, "    %s_tile_%d_data,\r\n",
                     tileset->image.name,
-                    i);
+                    tileset->tileMap[i]);
             }
         }
 
         fprintf(fds, "};\r\n");
     }
 
+    if (tileset->dedupe != TILESET_DEDUPE_NONE)
+    {
+        if (output_c_tile_map(tileset, fds))
+        {
+            fclose(fds);
+            goto error;
+        }
+    }
+
+    if (tileset_has_transforms(tileset))
+    {
+        fprintf(fds, "unsigned char %s_tile_transforms[%d] =\r\n{",
+            tileset->image.name,
+            tileset->numTiles);
+
+        output_c(tileset->tileFlags, tileset->numTiles, fds);
+    }
+
+    if (tileset->compressed && compress == COMPRESS_AUTO)
+    {
+        if (output_c_tile_compression(tileset, fds))
+        {
+            fclose(fds);
+            goto error;
+        }
+    }
+
     fclose(fds);
 
     free(header);
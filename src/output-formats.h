@@ -38,10 +38,28 @@ extern "C" {
 #include "output.h"
 #include "appvar.h"
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
 /*
  * Output is CRLF to please the Windows losers.
  */
 
+/*
+ * Hex text shared by the text formats.
+ */
+typedef struct
+{
+    const char *prefix;
+    const char *separator;
+    const char *lineBreak;
+    size_t bytesPerLine;
+    bool upper;
+} output_hex_format_t;
+
+int output_hex(FILE *fd, const uint8_t *data, size_t size, const output_hex_format_t *format);
+
 /*
  * C Format.
  */
@@ -69,15 +87,17 @@ int output_bin_include_file(output_t *output);
 /*
  * ICE Format.
  */
-int output_ice_image(image_t *image, char *file);
-int output_ice_tileset(tileset_t *tileset, char *file);
-int output_ice_palette(palette_t *palette, char *file);
+int output_ice_image(image_t *image, output_t *output);
+int output_ice_tileset(tileset_t *tileset, output_t *output);
+int output_ice_palette(palette_t *palette, output_t *output);
 int output_ice_include_file(output_t *output, char *file);
+int output_ice_close(output_t *output);
 
 /*
  * Appvar Format.
  */
 int output_appvar_image(image_t *image, appvar_t *appvar);
+int output_appvar_group(convert_t *convert, appvar_t *appvar);
 int output_appvar_tileset(tileset_t *tileset, appvar_t *appvar);
 int output_appvar_palette(palette_t *palette, appvar_t *appvar);
 int output_appvar_include_file(output_t *output, appvar_t *appvar);
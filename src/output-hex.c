@@ -0,0 +1,139 @@
+/*
+ * Copyright 2017-2019 Matt "MateoConLechuga" Waltz
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "output-formats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define OUTPUT_HEX_BUFFER_SIZE 65536
+
+typedef struct
+{
+    char data[OUTPUT_HEX_BUFFER_SIZE];
+    size_t size;
+    FILE *fd;
+} output_hex_buffer_t;
+
+/*
+ * Writes out the buffered text.
+ */
+static int output_hex_flush(output_hex_buffer_t *buffer)
+{
+    size_t size = buffer->size;
+
+    buffer->size = 0;
+
+    return fwrite(buffer->data, 1, size, buffer->fd) == size ? 0 : 1;
+}
+
+/*
+ * Appends a string to the buffer.
+ */
+static int output_hex_puts(output_hex_buffer_t *buffer, const char *str, size_t len)
+{
+    int ret = 0;
+
+    if (buffer->size + len > OUTPUT_HEX_BUFFER_SIZE)
+    {
+        ret = output_hex_flush(buffer);
+        if (len > OUTPUT_HEX_BUFFER_SIZE)
+        {
+            return ret | (fwrite(str, 1, len, buffer->fd) == len ? 0 : 1);
+        }
+    }
+
+    memcpy(&buffer->data[buffer->size], str, len);
+    buffer->size += len;
+
+    return ret;
+}
+
+/*
+ * Writes an array as hex text, formatting whole lines at a time.
+ * Bytes on a line are joined with the separator, and lines with the
+ * line break string. Nothing is written before the first byte or after
+ * the last one.
+ */
+int output_hex(FILE *fd, const uint8_t *data, size_t size, const output_hex_format_t *format)
+{
+    static const char lower[] = "0123456789abcdef";
+    static const char upper[] = "0123456789ABCDEF";
+    const char *digits = format->upper ? upper : lower;
+    size_t prefixLen = strlen(format->prefix);
+    size_t separatorLen = strlen(format->separator);
+    size_t lineBreakLen = strlen(format->lineBreak);
+    output_hex_buffer_t *buffer;
+    char item[64];
+    size_t i;
+    int ret = 0;
+
+    if (prefixLen + 2 > sizeof item)
+    {
+        return 1;
+    }
+
+    buffer = malloc(sizeof(output_hex_buffer_t));
+    if (buffer == NULL)
+    {
+        return 1;
+    }
+
+    buffer->size = 0;
+    buffer->fd = fd;
+
+    memcpy(item, format->prefix, prefixLen);
+
+    for (i = 0; i < size; ++i)
+    {
+        if (i != 0)
+        {
+            if (format->bytesPerLine > 0 && i % format->bytesPerLine == 0)
+            {
+                ret |= output_hex_puts(buffer, format->lineBreak, lineBreakLen);
+            }
+            else
+            {
+                ret |= output_hex_puts(buffer, format->separator, separatorLen);
+            }
+        }
+
+        item[prefixLen + 0] = digits[data[i] >> 4];
+        item[prefixLen + 1] = digits[data[i] & 15];
+
+        ret |= output_hex_puts(buffer, item, prefixLen + 2);
+    }
+
+    ret |= output_hex_flush(buffer);
+
+    free(buffer);
+
+    return ret;
+}
@@ -29,66 +29,120 @@
  */
 
 #include "output.h"
+#include "output-formats.h"
 #include "tileset.h"
 #include "strings.h"
 #include "image.h"
 #include "log.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <errno.h>
 #include <string.h>
 
+#define OUTPUT_ICE_BUFFER_SIZE (1024 * 1024)
+
 /*
  * Outputs to ICE format.
  */
 static int output_ice(unsigned char *data, size_t size, FILE *fd)
 {
-    size_t i;
+    static const output_hex_format_t format =
+    {
+        .prefix = "",
+        .separator = "",
+        .lineBreak = "",
+        .bytesPerLine = 0,
+        .upper = true,
+    };
+    int ret;
+
+    fputs("\"", fd);
+
+    ret = output_hex(fd, data, size, &format);
+
+    fputs("\"\r\n\r\n", fd);
 
-    fprintf(fd, "\"");
+    return ret;
+}
+
+/*
+ * Gets the include file of the output, opened on first use.
+ * It stays open until the include step so entries are streamed.
+ */
+static FILE *output_ice_file(output_t *output)
+{
+    if (output->includeFd != NULL)
+    {
+        return output->includeFd;
+    }
 
-    for (i = 0; i < size; ++i)
+    output->includeFd = fopen(output->includeFileName, "w");
+    if (output->includeFd == NULL)
     {
-        fprintf(fd, "%02X", data[i]);
+        LL_ERROR("Could not open file: %s", strerror(errno));
+        return NULL;
     }
 
-    fprintf(fd, "\"\r\n\r\n");
+    output->includeBuffer = malloc(OUTPUT_ICE_BUFFER_SIZE);
+    if (output->includeBuffer != NULL)
+    {
+        setvbuf(output->includeFd,
+                output->includeBuffer,
+                _IOFBF,
+                OUTPUT_ICE_BUFFER_SIZE);
+    }
 
-    return 0;
+    return output->includeFd;
 }
 
 /*
- * Outputs a converted C image.
+ * Closes the include file, returns nonzero if writing it failed.
  */
-int output_ice_image(image_t *image, char *file)
+int output_ice_close(output_t *output)
+{
+    int ret = 0;
+
+    if (output->includeFd != NULL)
+    {
+        ret = fclose(output->includeFd) == 0 ? 0 : 1;
+        output->includeFd = NULL;
+    }
+
+    free(output->includeBuffer);
+    output->includeBuffer = NULL;
+
+    return ret;
+}
+
+/*
+ * Outputs a converted ICE image.
+ */
+int output_ice_image(image_t *image, output_t *output)
 {
     FILE *fd;
 
-    fd = fopen(file, "a");
+    fd = output_ice_file(output);
     if (fd == NULL)
     {
-        LL_ERROR("Could not open file: %s", strerror(errno));
         return 1;
     }
 
     fprintf(fd, "%s | %d bytes\r\n", image->name, image->size);
-    output_ice(image->data, image->size, fd);
-
-    fclose(fd);
 
-    return 0;
+    return output_ice(image->data, image->size, fd);
 }
 
 /*
  * Outputs a converted ICE tileset.
  */
-int output_ice_tileset(tileset_t *tileset, char *file)
+int output_ice_tileset(tileset_t *tileset, output_t *output)
 {
     LL_ERROR("Tilesets are not supported for ICE output!");
 
     (void)tileset;
-    (void)file;
+    (void)output;
 
     return 1;
 }
@@ -96,34 +150,30 @@ int output_ice_tileset(tileset_t *tileset, char *file)
 /*
  * Outputs a converted C tileset.
  */
-int output_ice_palette(palette_t *palette, char *file)
+int output_ice_palette(palette_t *palette, output_t *output)
 {
     int size = palette->numEntries * 2;
+    uint8_t data[PALETTE_MAX_ENTRIES * 2];
     FILE *fd;
     int i;
 
-    fd = fopen(file, "a");
+    fd = output_ice_file(output);
     if (fd == NULL)
     {
-        LL_ERROR("Could not open file: %s", strerror(errno));
         return 1;
     }
 
-    fprintf(fd, "%s | %d bytes\r\n\"", palette->name, size);
-
     for (i = 0; i < palette->numEntries; ++i)
     {
         color_t *color = &palette->entries[i].color;
 
-        fprintf(fd, "%02X%02X",
-                color->target & 255,
-                (color->target >> 8) & 255);
+        data[i * 2 + 0] = color->target & 255;
+        data[i * 2 + 1] = (color->target >> 8) & 255;
     }
-    fprintf(fd, "\"\r\n\r\n");
 
-    fclose(fd);
+    fprintf(fd, "%s | %d bytes\r\n", palette->name, size);
 
-    return 0;
+    return output_ice(data, size, fd);
 }
 
 /*
@@ -131,9 +181,13 @@ int output_ice_palette(palette_t *palette, char *file)
  */
 int output_ice_include_file(output_t *output, char *file)
 {
-    LL_INFO(" - Wrote \'%s\'", file);
+    if (output_ice_close(output) != 0)
+    {
+        LL_ERROR("Could not write file \'%s\'", file);
+        return 1;
+    }
 
-    (void)output;
+    LL_INFO(" - Wrote \'%s\'", file);
 
     return 0;
 }
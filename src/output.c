@@ -65,8 +65,15 @@ output_t *output_alloc(void)
     output->appvar.init = true;
     output->appvar.source = APPVAR_SOURCE_C;
     output->appvar.compress = COMPRESS_NONE;
+    output->appvar.compressLevel = COMPRESS_LEVEL_OPTIMAL;
+    output->appvar.compressGroups = false;
+    output->appvar.compressAuto = false;
+    output->appvar.tilesets = NULL;
+    output->appvar.numTilesets = 0;
     output->appvar.data = malloc(APPVAR_MAX_DATA_SIZE);
     output->appvar.size = 0;
+    output->includeFd = NULL;
+    output->includeBuffer = NULL;
 
     return output;
 }
@@ -137,6 +144,8 @@ void output_free(output_t *output)
         return;
     }
 
+    output_ice_close(output);
+
     for (i = 0; i < output->numConverts; ++i)
     {
         free(output->convertNames[i]);
@@ -161,6 +170,16 @@ void output_free(output_t *output)
     free(output->appvar.data);
     output->appvar.data = NULL;
 
+    for (i = 0; i < output->appvar.numTilesets; ++i)
+    {
+        free(output->appvar.tilesets[i].copy.tiles);
+        free(output->appvar.tilesets[i].copy.slab);
+    }
+
+    free(output->appvar.tilesets);
+    output->appvar.tilesets = NULL;
+    output->appvar.numTilesets = 0;
+
     free(output->converts);
     output->converts = NULL;
 
@@ -345,11 +364,15 @@ int output_converts(output_t *output, convert_t **converts, int numConverts)
                     break;
 
                 case OUTPUT_FORMAT_ICE:
-                    ret = output_ice_image(image, output->includeFileName);
+                    ret = output_ice_image(image, output);
                     break;
 
                 case OUTPUT_FORMAT_APPVAR:
-                    ret = output_appvar_image(image, &output->appvar);
+                    /* grouped images are written together below */
+                    if (!output->appvar.compressGroups)
+                    {
+                        ret = output_appvar_image(image, &output->appvar);
+                    }
                     break;
 
                 case OUTPUT_FORMAT_BIN:
@@ -364,6 +387,13 @@ int output_converts(output_t *output, convert_t **converts, int numConverts)
             free(image->directory);
         }
 
+        if (ret == 0 &&
+            output->format == OUTPUT_FORMAT_APPVAR &&
+            output->appvar.compressGroups)
+        {
+            ret = output_appvar_group(convert, &output->appvar);
+        }
+
         for (j = 0; j < convert->numTilesetGroups; ++j)
         {
             tileset_group_t *tilesetGroup = convert->tilesetGroups[j];
@@ -395,7 +425,7 @@ int output_converts(output_t *output, convert_t **converts, int numConverts)
                         break;
 
                     case OUTPUT_FORMAT_ICE:
-                        ret = output_ice_tileset(tileset, output->includeFileName);
+                        ret = output_ice_tileset(tileset, output);
                         break;
 
                     case OUTPUT_FORMAT_APPVAR:
@@ -464,7 +494,7 @@ int output_palettes(output_t *output, palette_t **palettes, int numPalettes)
                 break;
 
             case OUTPUT_FORMAT_ICE:
-                ret = output_ice_palette(palette, output->includeFileName);
+                ret = output_ice_palette(palette, output);
                 break;
 
             case OUTPUT_FORMAT_APPVAR:
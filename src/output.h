@@ -41,6 +41,7 @@ extern "C" {
 #include "compress.h"
 
 #include <stdint.h>
+#include <stdio.h>
 
 typedef enum
 {
@@ -66,6 +67,10 @@ typedef struct
     output_format_t format;
     compress_t compress;
     appvar_t appvar;
+
+    /* streamed include file, used by ice */
+    FILE *includeFd;
+    char *includeBuffer;
 } output_t;
 
 output_t *output_alloc(void);
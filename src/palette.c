@@ -32,6 +32,8 @@
 #include "convert.h"
 #include "strings.h"
 #include "image.h"
+#include "cache.h"
+#include "remap.h"
 #include "log.h"
 
 #include "deps/libimagequant/libimagequant.h"
@@ -70,6 +72,9 @@ palette_t *palette_alloc(void)
     palette->mode = COLOR_MODE_1555_GBGR;
     palette->quantizeSpeed = PALETTE_DEFAULT_QUANTIZE_SPEED;
     palette->automatic = false;
+    palette->remapTable = NULL;
+    palette->liqAttr = NULL;
+    memset(palette->liqResults, 0, sizeof palette->liqResults);
 
     return palette;
 }
@@ -169,6 +174,8 @@ void palette_free(palette_t *palette)
     free(palette->images);
     palette->images = NULL;
 
+    remap_free(palette);
+
     free(palette->name);
     palette->name = NULL;
 }
@@ -247,6 +254,159 @@ error:
     return ret;
 }
 
+/*
+ * Registers the image loads palette generation will make with the
+ * decoded image cache, before any palette is generated.
+ */
+void palette_expect_images(const palette_t *palette, convert_t **converts, int numConverts)
+{
+    int i, j, k;
+
+    if (!strcmp(palette->name, "xlibc") || !strcmp(palette->name, "rgb332"))
+    {
+        return;
+    }
+
+    for (i = 0; i < palette->numImages; ++i)
+    {
+        image_cache_expect(palette->images[i].path);
+    }
+
+    if (!palette->automatic)
+    {
+        return;
+    }
+
+    for (i = 0; i < numConverts; ++i)
+    {
+        if (strcmp(palette->name, converts[i]->paletteName))
+        {
+            continue;
+        }
+
+        for (j = 0; j < converts[i]->numImages; ++j)
+        {
+            image_cache_expect(converts[i]->images[j].path);
+        }
+
+        for (j = 0; j < converts[i]->numTilesetGroups; ++j)
+        {
+            tileset_group_t *tilesetGroup = converts[i]->tilesetGroups[j];
+
+            for (k = 0; k < tilesetGroup->numTilesets; ++k)
+            {
+                image_cache_expect(tilesetGroup->tilesets[k].image.path);
+            }
+        }
+    }
+}
+
+/*
+ * Builds the cache key of a generated palette from its images and options.
+ */
+static int palette_cache_key(palette_t *palette, cache_key_t *key)
+{
+    int i;
+
+    cache_key_init(key, "palette");
+
+    cache_key_add_int(key, palette->mode);
+    cache_key_add_int(key, palette->maxEntries);
+    cache_key_add_int(key, palette->quantizeSpeed);
+    cache_key_add_int(key, palette->numFixedEntries);
+    for (i = 0; i < palette->numFixedEntries; ++i)
+    {
+        palette_entry_t *entry = &palette->fixedEntries[i];
+
+        cache_key_add(key, &entry->color.rgb, sizeof(liq_color));
+        cache_key_add_int(key, entry->index);
+    }
+
+    cache_key_add_int(key, palette->numImages);
+    for (i = 0; i < palette->numImages; ++i)
+    {
+        if (cache_key_add_file(key, palette->images[i].path) != 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Restores generated palette entries from the cache.
+ */
+static int palette_cache_load(palette_t *palette, const cache_key_t *key)
+{
+    palette_entry_t entries[PALETTE_MAX_ENTRIES];
+    cache_blob_t blob;
+    int numEntries;
+    int ret = 1;
+    int i;
+
+    if (cache_load(key, "pal", &blob) != 0)
+    {
+        return 1;
+    }
+
+    if (cache_blob_read_int(&blob, &numEntries) != 0 ||
+        numEntries < 0 || numEntries > PALETTE_MAX_ENTRIES)
+    {
+        goto error;
+    }
+
+    for (i = 0; i < numEntries; ++i)
+    {
+        int target, index;
+
+        if (cache_blob_read(&blob, &entries[i].color.rgb, sizeof(liq_color)) != 0 ||
+            cache_blob_read_int(&blob, &target) != 0 ||
+            cache_blob_read_int(&blob, &index) != 0)
+        {
+            goto error;
+        }
+
+        entries[i].color.target = target;
+        entries[i].index = index;
+    }
+
+    memcpy(palette->entries, entries, numEntries * sizeof(palette_entry_t));
+    palette->numEntries = numEntries;
+    ret = 0;
+
+error:
+    cache_blob_free(&blob);
+    return ret;
+}
+
+/*
+ * Stores generated palette entries in the cache.
+ */
+static void palette_cache_store(palette_t *palette, const cache_key_t *key)
+{
+    cache_blob_t blob = { NULL, 0, 0 };
+    int ret;
+    int i;
+
+    ret = cache_blob_write_int(&blob, palette->numEntries);
+    for (i = 0; i < palette->numEntries && ret == 0; ++i)
+    {
+        palette_entry_t *entry = &palette->entries[i];
+
+        ret |= cache_blob_write(&blob, &entry->color.rgb, sizeof(liq_color));
+        ret |= cache_blob_write_int(&blob, entry->color.target);
+        ret |= cache_blob_write_int(&blob, entry->index);
+    }
+
+    if (ret == 0)
+    {
+        cache_store(key, "pal", &blob);
+    }
+
+    cache_blob_free(&blob);
+}
+
 /*
  * Reads all input images, and generates a palette for convert.
  */
@@ -257,6 +417,8 @@ int palette_generate(palette_t *palette, convert_t **converts, int numConverts)
     liq_result *liqresult = NULL;
     const liq_palette *liqpalette = NULL;
     liq_error liqerr;
+    cache_key_t key;
+    bool cached;
     int i, j;
     int ret;
 
@@ -297,6 +459,22 @@ int palette_generate(palette_t *palette, convert_t **converts, int numConverts)
         return 1;
     }
 
+    cached = cache_enabled() && palette_cache_key(palette, &key) == 0;
+    if (cached && palette_cache_load(palette, &key) == 0)
+    {
+        for (i = 0; i < palette->numFixedEntries; ++i)
+        {
+            color_convert(&palette->fixedEntries[i].color, palette->mode);
+        }
+
+        for (i = 0; i < palette->numImages; ++i)
+        {
+            image_cache_skip(palette->images[i].path);
+        }
+
+        return 0;
+    }
+
     attr = liq_attr_create();
 
     liq_set_speed(attr, palette->quantizeSpeed);
@@ -317,7 +495,6 @@ int palette_generate(palette_t *palette, convert_t **converts, int numConverts)
     {
         image_t *image = &palette->images[i];
         liq_image *liqimage;
-        int j;
 
         LL_INFO(" - Reading \'%s\'",
             image->path);
@@ -330,22 +507,9 @@ int palette_generate(palette_t *palette, convert_t **converts, int numConverts)
             return 1;
         }
 
-        for (j = 0; j < image->width * image->height; ++j)
-        {
-            int o = j * 4;
-            color_t color;
-            color.rgb.r = image->data[o + 0];
-            color.rgb.g = image->data[o + 1];
-            color.rgb.b = image->data[o + 2];
-            color.rgb.a = image->data[o + 3];
-
-            color_convert(&color, palette->mode);
-
-            image->data[o + 0] = color.rgb.r;
-            image->data[o + 1] = color.rgb.g;
-            image->data[o + 2] = color.rgb.b;
-            image->data[o + 3] = color.rgb.a;
-        }
+        color_convert_buffer(image->data,
+                             (size_t)image->width * image->height,
+                             palette->mode);
 
         liqimage = liq_image_create_rgba(attr,
                                          image->data,
@@ -409,6 +573,11 @@ int palette_generate(palette_t *palette, convert_t **converts, int numConverts)
     liq_histogram_destroy(hist);
     liq_attr_destroy(attr);
 
+    if (cached)
+    {
+        palette_cache_store(palette, &key);
+    }
+
     return 0;
 }
 
@@ -38,6 +38,7 @@ extern "C" {
 #include "bpp.h"
 #include "image.h"
 #include "color.h"
+#include "thread.h"
 
 #include "deps/libimagequant/libimagequant.h"
 
@@ -68,6 +69,11 @@ typedef struct palette
     bpp_t bpp;
     bool automatic;
 
+    /* set by convert */
+    uint8_t *remapTable;
+    liq_attr *liqAttr;
+    liq_result *liqResults[THREAD_MAX_COUNT];
+
     /* set by output */
     char *directory;
 } palette_t;
@@ -78,6 +84,7 @@ typedef struct convert convert_t;
 palette_t *palette_alloc(void);
 void palette_free(palette_t *palette);
 int pallete_add_path(palette_t *palette, const char *path);
+void palette_expect_images(const palette_t *palette, convert_t **converts, int numConverts);
 int palette_generate(palette_t *palette, convert_t **converts, int numConverts);
 
 #ifdef __cplusplus
@@ -0,0 +1,427 @@
+/*
+ * Copyright 2017-2019 Matt "MateoConLechuga" Waltz
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "remap.h"
+#include "thread.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Gets the table index of a color.
+ */
+static inline unsigned int remap_index(int r, int g, int b)
+{
+    unsigned int r5 = (r * 31 + 127) / 255;
+    unsigned int g6 = (g * 63 + 127) / 255;
+    unsigned int b5 = (b * 31 + 127) / 255;
+
+    return (r5 << 11) | (g6 << 5) | b5;
+}
+
+/*
+ * Premultiplies a color channel by alpha.
+ */
+static inline int remap_premultiply(int c, int a)
+{
+    return (c * a + 127) / 255;
+}
+
+/*
+ * Builds the nearest palette index for every 565 color.
+ * Only done once per palette, images then use a lookup per pixel.
+ */
+static int remap_direct_build(palette_t *palette)
+{
+    uint8_t *table;
+    unsigned int i;
+
+    if (palette->remapTable != NULL)
+    {
+        return 0;
+    }
+
+    table = malloc(REMAP_TABLE_SIZE);
+    if (table == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    for (i = 0; i < REMAP_TABLE_SIZE; ++i)
+    {
+        int r = (((i >> 11) & 31) * 255 + 15) / 31;
+        int g = (((i >> 5) & 63) * 255 + 31) / 63;
+        int b = ((i & 31) * 255 + 15) / 31;
+        int best = 0;
+        int bestDist = 0x7fffffff;
+        int j;
+
+        for (j = 0; j < palette->numEntries; ++j)
+        {
+            liq_color *color = &palette->entries[j].color.rgb;
+            int dr = r - color->r;
+            int dg = g - color->g;
+            int db = b - color->b;
+            int dist = dr * dr + dg * dg + db * db;
+
+            if (dist < bestDist)
+            {
+                bestDist = dist;
+                best = j;
+            }
+        }
+
+        table[i] = best;
+    }
+
+    palette->remapTable = table;
+
+    return 0;
+}
+
+/*
+ * Clamps a value to a color channel.
+ */
+static inline int remap_clamp(int c)
+{
+    return c < 0 ? 0 : c > 255 ? 255 : c;
+}
+
+/*
+ * Remaps an image with Floyd-Steinberg dithering.
+ */
+static int remap_image_dither(image_t *image,
+                              palette_t *palette,
+                              uint8_t *data)
+{
+    int width = image->width;
+    int *err = calloc((width + 2) * 3 * 2, sizeof(int));
+    int *cur, *next, *tmp;
+    int x, y;
+
+    if (err == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    cur = err;
+    next = err + (width + 2) * 3;
+
+    for (y = 0; y < image->height; ++y)
+    {
+        const uint8_t *src = &image->data[y * width * 4];
+
+        memset(next, 0, (width + 2) * 3 * sizeof(int));
+
+        for (x = 0; x < width; ++x)
+        {
+            int a = src[x * 4 + 3];
+            int *e = &cur[(x + 1) * 3];
+            int c[3];
+            liq_color *color;
+            int i;
+
+            for (i = 0; i < 3; ++i)
+            {
+                c[i] = remap_clamp(remap_premultiply(src[x * 4 + i], a) + e[i] / 16);
+            }
+
+            data[y * width + x] = palette->remapTable[remap_index(c[0], c[1], c[2])];
+            color = &palette->entries[data[y * width + x]].color.rgb;
+
+            c[0] -= color->r;
+            c[1] -= color->g;
+            c[2] -= color->b;
+
+            for (i = 0; i < 3; ++i)
+            {
+                e[3 + i] += c[i] * 7;
+                next[x * 3 + i] += c[i] * 3;
+                next[(x + 1) * 3 + i] += c[i] * 5;
+                next[(x + 2) * 3 + i] += c[i];
+            }
+        }
+
+        tmp = cur;
+        cur = next;
+        next = tmp;
+    }
+
+    free(err);
+
+    return 0;
+}
+
+/*
+ * Remaps an image to the palette using the prebuilt table.
+ */
+static int remap_direct_image(image_t *image, palette_t *palette, bool dither, uint8_t *data)
+{
+    int i;
+
+    if (dither)
+    {
+        return remap_image_dither(image, palette, data);
+    }
+    else
+    {
+        for (i = 0; i < image->size; ++i)
+        {
+            const uint8_t *src = &image->data[i * 4];
+            int a = src[3];
+
+            data[i] = palette->remapTable[
+                remap_index(remap_premultiply(src[0], a),
+                            remap_premultiply(src[1], a),
+                            remap_premultiply(src[2], a))];
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Creates a libimagequant result holding exactly the palette colors.
+ * Remapping with it skips quantization, but the result is not safe to
+ * share between threads, so each thread gets its own.
+ */
+static liq_result *remap_liq_result(palette_t *palette)
+{
+    liq_result *liqresult = NULL;
+    liq_image *liqimage;
+    liq_color *colors;
+    int i;
+
+    colors = malloc(palette->numEntries * sizeof(liq_color));
+    if (colors == NULL)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < palette->numEntries; ++i)
+    {
+        colors[i] = palette->entries[i].color.rgb;
+        colors[i].a = 255;
+    }
+
+    liqimage = liq_image_create_rgba(palette->liqAttr,
+                                     colors,
+                                     palette->numEntries,
+                                     1,
+                                     0);
+    if (liqimage != NULL)
+    {
+        for (i = 0; i < palette->numEntries; ++i)
+        {
+            liq_image_add_fixed_color(liqimage, colors[i]);
+        }
+
+        liqresult = liq_quantize_image(palette->liqAttr, liqimage);
+        liq_image_destroy(liqimage);
+    }
+
+    free(colors);
+
+    return liqresult;
+}
+
+/*
+ * Builds a libimagequant remapper for each of count threads.
+ */
+static int remap_liq_build(palette_t *palette, int count)
+{
+    int i;
+
+    if (palette->liqAttr == NULL)
+    {
+        palette->liqAttr = liq_attr_create();
+        if (palette->liqAttr == NULL)
+        {
+            LL_ERROR("Failed to create palette attributes \'%s\'", palette->name);
+            return 1;
+        }
+
+        liq_set_speed(palette->liqAttr, 10);
+        liq_set_max_colors(palette->liqAttr, palette->numEntries);
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (palette->liqResults[i] != NULL)
+        {
+            continue;
+        }
+
+        palette->liqResults[i] = remap_liq_result(palette);
+        if (palette->liqResults[i] == NULL)
+        {
+            LL_ERROR("Failed to create remapper for palette \'%s\'", palette->name);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Remaps an image using this thread's libimagequant remapper.
+ */
+static int remap_liq_image(image_t *image, palette_t *palette, bool dither, uint8_t *data)
+{
+    liq_result *liqresult = palette->liqResults[thread_index()];
+    liq_image *liqimage;
+
+    if (liqresult == NULL)
+    {
+        LL_DEBUG("Missing remapper in %s", __func__);
+        return 1;
+    }
+
+    liqimage = liq_image_create_rgba(palette->liqAttr,
+                                     image->data,
+                                     image->width,
+                                     image->height,
+                                     0);
+    if (liqimage == NULL)
+    {
+        LL_ERROR("Failed to create image \'%s\'", image->path);
+        return 1;
+    }
+
+    liq_set_dithering_level(liqresult, dither ? 1.0f : 0.0f);
+    liq_write_remapped_image(liqresult, liqimage, data, image->size);
+    liq_image_destroy(liqimage);
+
+    return 0;
+}
+
+/*
+ * Prepares a palette for remapping images, only done once per palette.
+ * Count is the number of threads that will remap with it.
+ */
+int remap_build(palette_t *palette, remap_t mode, int count)
+{
+    if (palette == NULL || palette->numEntries <= 0 ||
+        count <= 0 || count > THREAD_MAX_COUNT)
+    {
+        LL_DEBUG("Invalid param in %s", __func__);
+        return 1;
+    }
+
+    switch (mode)
+    {
+        case REMAP_DIRECT:
+            return remap_direct_build(palette);
+
+        case REMAP_LIQ:
+            return remap_liq_build(palette, count);
+    }
+
+    return 1;
+}
+
+/*
+ * Remaps an image to palette indices.
+ */
+int remap_image(image_t *image, palette_t *palette, remap_t mode, bool dither)
+{
+    uint8_t *data;
+    int ret = 1;
+
+    if (image == NULL || palette == NULL)
+    {
+        LL_DEBUG("Invalid param in %s", __func__);
+        return 1;
+    }
+
+    data = malloc(image->size);
+    if (data == NULL)
+    {
+        LL_ERROR("Failed to allocate image memory \'%s\'", image->path);
+        return 1;
+    }
+
+    switch (mode)
+    {
+        case REMAP_DIRECT:
+            ret = palette->remapTable == NULL ? 1 :
+                remap_direct_image(image, palette, dither, data);
+            break;
+
+        case REMAP_LIQ:
+            ret = remap_liq_image(image, palette, dither, data);
+            break;
+    }
+
+    if (ret != 0)
+    {
+        free(data);
+        return ret;
+    }
+
+    free(image->data);
+    image->data = data;
+
+    return 0;
+}
+
+/*
+ * Frees the remapping state of a palette.
+ */
+void remap_free(palette_t *palette)
+{
+    int i;
+
+    if (palette == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < THREAD_MAX_COUNT; ++i)
+    {
+        if (palette->liqResults[i] != NULL)
+        {
+            liq_result_destroy(palette->liqResults[i]);
+            palette->liqResults[i] = NULL;
+        }
+    }
+
+    if (palette->liqAttr != NULL)
+    {
+        liq_attr_destroy(palette->liqAttr);
+        palette->liqAttr = NULL;
+    }
+
+    free(palette->remapTable);
+    palette->remapTable = NULL;
+}
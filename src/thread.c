@@ -0,0 +1,330 @@
+/*
+ * Copyright 2017-2019 Matt "MateoConLechuga" Waltz
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "thread.h"
+#include "log.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct thread_batch
+{
+    thread_job_t job;
+    void *arg;
+    int numJobs;
+    int next;
+    int pending;
+    int *results;
+    struct thread_batch *link;
+} thread_batch_t;
+
+static pthread_mutex_t thread_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t thread_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t thread_done = PTHREAD_COND_INITIALIZER;
+static pthread_t thread_workers[THREAD_MAX_COUNT];
+static int thread_num_workers = 0;
+static int thread_count = 1;
+static bool thread_exit = false;
+static thread_batch_t *thread_batches = NULL;
+static __thread int thread_id = 0;
+
+/*
+ * Gets the number of processors available.
+ */
+static int thread_detect_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+
+    return (int)info.dwNumberOfProcessors;
+#else
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+/*
+ * Sets the number of threads used for running jobs.
+ * A count less than 1 uses the number of available processors.
+ */
+void thread_set_count(int count)
+{
+    if (count < 1)
+    {
+        count = thread_detect_count();
+    }
+
+    if (count < 1)
+    {
+        count = 1;
+    }
+    else if (count > THREAD_MAX_COUNT)
+    {
+        count = THREAD_MAX_COUNT;
+    }
+
+    thread_count = count;
+}
+
+/*
+ * Gets the number of threads used for running jobs.
+ */
+int thread_get_count(void)
+{
+    return thread_count;
+}
+
+/*
+ * Gets the index of the calling thread, in the range [0, count).
+ * The main thread is always index 0.
+ */
+int thread_index(void)
+{
+    return thread_id;
+}
+
+/*
+ * Removes a batch from the list of batches with unclaimed jobs.
+ * Must be called with the lock held.
+ */
+static void thread_unlink_batch(thread_batch_t *batch)
+{
+    thread_batch_t **curr;
+
+    for (curr = &thread_batches; *curr != NULL; curr = &(*curr)->link)
+    {
+        if (*curr == batch)
+        {
+            *curr = batch->link;
+            break;
+        }
+    }
+}
+
+/*
+ * Claims and runs the next job of a batch.
+ * Must be called with the lock held; the lock is released while running.
+ */
+static void thread_run_next(thread_batch_t *batch)
+{
+    int index = batch->next++;
+    int ret;
+
+    if (batch->next == batch->numJobs)
+    {
+        thread_unlink_batch(batch);
+    }
+
+    pthread_mutex_unlock(&thread_lock);
+    ret = batch->job(batch->arg, index);
+    pthread_mutex_lock(&thread_lock);
+
+    batch->results[index] = ret;
+    batch->pending--;
+
+    /* stop handing out jobs from a batch once one has failed */
+    if (ret != 0 && batch->next < batch->numJobs)
+    {
+        batch->pending -= batch->numJobs - batch->next;
+        batch->next = batch->numJobs;
+        thread_unlink_batch(batch);
+    }
+
+    if (batch->pending == 0)
+    {
+        pthread_cond_broadcast(&thread_done);
+    }
+}
+
+/*
+ * Worker thread, runs jobs from any batch until shutdown.
+ */
+static void *thread_worker(void *arg)
+{
+    thread_id = (int)(size_t)arg;
+
+    pthread_mutex_lock(&thread_lock);
+
+    for (;;)
+    {
+        while (thread_exit == false && thread_batches == NULL)
+        {
+            pthread_cond_wait(&thread_work, &thread_lock);
+        }
+
+        if (thread_exit)
+        {
+            break;
+        }
+
+        thread_run_next(thread_batches);
+    }
+
+    pthread_mutex_unlock(&thread_lock);
+
+    return NULL;
+}
+
+/*
+ * Starts the worker threads if they are not running yet.
+ * Must be called with the lock held.
+ */
+static void thread_start_workers(void)
+{
+    while (thread_num_workers < thread_count - 1)
+    {
+        size_t id = thread_num_workers + 1;
+
+        if (pthread_create(&thread_workers[thread_num_workers], NULL,
+                           thread_worker, (void *)id) != 0)
+        {
+            LL_WARNING("Could not create worker thread, using %d thread(s).", (int)id);
+            thread_count = id;
+            break;
+        }
+
+        thread_num_workers++;
+    }
+}
+
+/*
+ * Runs a job for each index in the range [0, numJobs), spreading the jobs
+ * across the available threads. Jobs may themselves call this function.
+ * Once a job fails no further jobs are started.
+ * Returns the result of the lowest indexed job that failed, otherwise 0.
+ */
+int thread_run(thread_job_t job, void *arg, int numJobs)
+{
+    thread_batch_t batch;
+    int ret = 0;
+    int i;
+
+    if (numJobs <= 0)
+    {
+        return 0;
+    }
+
+    if (thread_count <= 1 || numJobs == 1)
+    {
+        for (i = 0; i < numJobs; ++i)
+        {
+            ret = job(arg, i);
+            if (ret != 0)
+            {
+                break;
+            }
+        }
+
+        return ret;
+    }
+
+    batch.results = calloc(numJobs, sizeof(int));
+    if (batch.results == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        return 1;
+    }
+
+    batch.job = job;
+    batch.arg = arg;
+    batch.numJobs = numJobs;
+    batch.next = 0;
+    batch.pending = numJobs;
+
+    pthread_mutex_lock(&thread_lock);
+
+    thread_start_workers();
+
+    batch.link = thread_batches;
+    thread_batches = &batch;
+    pthread_cond_broadcast(&thread_work);
+
+    while (batch.next < batch.numJobs)
+    {
+        thread_run_next(&batch);
+    }
+
+    /* help out with other batches while waiting for the last jobs */
+    while (batch.pending > 0)
+    {
+        if (thread_batches != NULL)
+        {
+            thread_run_next(thread_batches);
+        }
+        else
+        {
+            pthread_cond_wait(&thread_done, &thread_lock);
+        }
+    }
+
+    pthread_mutex_unlock(&thread_lock);
+
+    for (i = 0; i < numJobs; ++i)
+    {
+        if (batch.results[i] != 0)
+        {
+            ret = batch.results[i];
+            break;
+        }
+    }
+
+    free(batch.results);
+
+    return ret;
+}
+
+/*
+ * Stops all worker threads.
+ */
+void thread_shutdown(void)
+{
+    int i;
+
+    pthread_mutex_lock(&thread_lock);
+    thread_exit = true;
+    pthread_cond_broadcast(&thread_work);
+    pthread_mutex_unlock(&thread_lock);
+
+    for (i = 0; i < thread_num_workers; ++i)
+    {
+        pthread_join(thread_workers[i], NULL);
+    }
+
+    thread_num_workers = 0;
+    thread_exit = false;
+}
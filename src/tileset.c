@@ -29,6 +29,7 @@
  */
 
 #include "tileset.h"
+#include "log.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -49,8 +50,13 @@ tileset_t *tileset_alloc(void)
     tileset->tileHeight = 16;
     tileset->tileWidth = 16;
     tileset->pTable = true;
+    tileset->dedupe = TILESET_DEDUPE_NONE;
     tileset->tiles = NULL;
     tileset->numTiles = 0;
+    tileset->tileMap = NULL;
+    tileset->tileFlags = NULL;
+    tileset->slab = NULL;
+    tileset->numUniqueTiles = 0;
     tileset->image.name = NULL;
     tileset->image.path = NULL;
     tileset->image.data = NULL;
@@ -78,12 +84,14 @@ tileset_group_t *tileset_group_alloc(void)
     tilesetGroup->tileHeight = 16;
     tilesetGroup->tileWidth = 16;
     tilesetGroup->pTable = true;
+    tilesetGroup->dedupe = TILESET_DEDUPE_NONE;
 
     return tilesetGroup;
 }
 
 /*
- * Allocates storage for each tile.
+ * Allocates storage for each tile. Tile data is a view into a single
+ * slab shared by the whole tileset.
  */
 int tileset_alloc_tiles(tileset_t *tileset)
 {
@@ -91,50 +99,331 @@ int tileset_alloc_tiles(tileset_t *tileset)
     int tileSize = tileset->tileWidth * tileset->tileHeight;
 
     tileset->tiles =
-        malloc(tileset->numTiles * sizeof(tileset_tile_t));
-    if (tileset->tiles == NULL)
+        calloc(tileset->numTiles, sizeof(tileset_tile_t));
+    tileset->tileMap =
+        malloc(tileset->numTiles * sizeof(int));
+    tileset->tileFlags =
+        calloc(tileset->numTiles, sizeof(uint8_t));
+    tileset->slab =
+        malloc((size_t)tileset->numTiles * tileSize + 1);
+    if (tileset->tiles == NULL ||
+        tileset->tileMap == NULL ||
+        tileset->tileFlags == NULL ||
+        tileset->slab == NULL)
     {
         return 1;
     }
 
     for (i = 0; i < tileset->numTiles; ++i)
     {
-        tileset->tiles[i].data = malloc(tileSize);
-        if (tileset->tiles[i].data == NULL)
+        tileset->tiles[i].data = tileset->slab + (size_t)i * tileSize;
+        tileset->tiles[i].size = tileSize;
+        tileset->tileMap[i] = i;
+    }
+
+    tileset->numUniqueTiles = tileset->numTiles;
+
+    return 0;
+}
+
+/*
+ * Replaces the tileset slab. The stored tiles are laid out back to back
+ * in the new slab using their current sizes.
+ */
+void tileset_set_slab(tileset_t *tileset, uint8_t *slab)
+{
+    size_t offset = 0;
+    int i;
+
+    for (i = 0; i < tileset->numUniqueTiles; ++i)
+    {
+        tileset->tiles[i].data = slab + offset;
+        offset += tileset->tiles[i].size;
+    }
+
+    if (tileset->slab != slab)
+    {
+        free(tileset->slab);
+        tileset->slab = slab;
+    }
+}
+
+/*
+ * Hashes tile data (FNV-1a).
+ */
+static uint32_t tileset_tile_hash(const uint8_t *data, int size)
+{
+    uint32_t hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+ * Applies transform flags to tile data.
+ */
+static void tileset_tile_transform(const uint8_t *src, uint8_t *dst, int width, int height, int flags)
+{
+    int outWidth = flags & TILESET_TRANSPOSE ? height : width;
+    int outHeight = flags & TILESET_TRANSPOSE ? width : height;
+    int x, y;
+
+    for (y = 0; y < outHeight; ++y)
+    {
+        int y1 = flags & TILESET_FLIP_Y ? outHeight - 1 - y : y;
+
+        for (x = 0; x < outWidth; ++x)
         {
-            return 1;
+            int x1 = flags & TILESET_FLIP_X ? outWidth - 1 - x : x;
+
+            dst[y * outWidth + x] = flags & TILESET_TRANSPOSE ?
+                src[x1 * width + y1] : src[y1 * width + x1];
         }
+    }
+}
 
-        tileset->tiles[i].size = tileSize;
+/*
+ * Removes duplicate tiles, keeping the first of each in tile order.
+ * With flip or rotate, a tile also matches a stored tile that becomes it
+ * once the tile's transform flags are applied.
+ */
+int tileset_dedupe(tileset_t *tileset)
+{
+    /* flags that undo each transform */
+    static const int inverse[8] = { 0, 1, 2, 3, 4, 6, 5, 7 };
+    int tileSize = tileset->tileWidth * tileset->tileHeight;
+    int numFlags;
+    uint8_t *scratch;
+    int *table;
+    int tableSize = 1;
+    int numUnique = 0;
+    int i;
+
+    switch (tileset->dedupe)
+    {
+        case TILESET_DEDUPE_FLIP:
+            numFlags = 4;
+            break;
+        case TILESET_DEDUPE_ROTATE:
+            numFlags = 8;
+            break;
+        default:
+            numFlags = 1;
+            break;
+    }
+
+    if (numFlags > 4 && tileset->tileWidth != tileset->tileHeight)
+    {
+        LL_ERROR("Tile rotation requires square tiles.");
+        return 1;
+    }
+
+    while (tableSize < tileset->numTiles * 2)
+    {
+        tableSize <<= 1;
+    }
+
+    table = malloc(tableSize * sizeof(int));
+    scratch = malloc(tileSize + 1);
+    if (table == NULL || scratch == NULL)
+    {
+        LL_DEBUG("Memory error in %s", __func__);
+        free(table);
+        free(scratch);
+        return 1;
+    }
+
+    memset(table, 0xff, tableSize * sizeof(int));
+
+    for (i = 0; i < tileset->numTiles; ++i)
+    {
+        tileset_tile_t *tile = &tileset->tiles[i];
+        int emptySlot = -1;
+        int flags;
+
+        for (flags = 0; flags < numFlags; ++flags)
+        {
+            const uint8_t *data = tile->data;
+            int slot;
+
+            if (flags != 0)
+            {
+                tileset_tile_transform(tile->data,
+                                       scratch,
+                                       tileset->tileWidth,
+                                       tileset->tileHeight,
+                                       inverse[flags]);
+                data = scratch;
+            }
+
+            slot = tileset_tile_hash(data, tileSize) & (tableSize - 1);
+
+            /* linear probe until a match or an empty slot */
+            while (table[slot] >= 0)
+            {
+                if (!memcmp(tileset->tiles[table[slot]].data, data, tileSize))
+                {
+                    break;
+                }
+
+                slot = (slot + 1) & (tableSize - 1);
+            }
+
+            if (table[slot] >= 0)
+            {
+                tileset->tileMap[i] = table[slot];
+                tileset->tileFlags[i] = flags;
+                break;
+            }
+
+            if (flags == 0)
+            {
+                emptySlot = slot;
+            }
+        }
+
+        if (flags == numFlags)
+        {
+            table[emptySlot] = numUnique;
+            tileset->tileMap[i] = numUnique;
+            tileset->tileFlags[i] = 0;
+            tileset->tiles[numUnique] = *tile;
+            numUnique++;
+        }
+    }
+
+    for (i = numUnique; i < tileset->numTiles; ++i)
+    {
+        tileset->tiles[i].data = NULL;
+        tileset->tiles[i].size = 0;
     }
 
+    tileset->numUniqueTiles = numUnique;
+
+    free(scratch);
+    free(table);
+
     return 0;
 }
 
 /*
- * Frees an allocated tileset.
+ * Gets the size in bytes of each tile map entry.
  */
-void tileset_free(tileset_t *tileset)
+int tileset_map_entry_size(const tileset_t *tileset)
+{
+    return tileset->numUniqueTiles > 256 ? 2 : 1;
+}
+
+/*
+ * Checks if tiles may be stored flipped or rotated.
+ */
+bool tileset_has_transforms(const tileset_t *tileset)
+{
+    return tileset->dedupe == TILESET_DEDUPE_FLIP ||
+           tileset->dedupe == TILESET_DEDUPE_ROTATE;
+}
+
+/*
+ * Gets the format shared by all stored tiles.
+ * Returns COMPRESS_AUTO if tiles were compressed differently.
+ */
+compress_t tileset_compress(const tileset_t *tileset)
 {
     int i;
 
-    if (tileset == NULL)
+    for (i = 1; i < tileset->numUniqueTiles; ++i)
     {
-        return;
+        if (tileset->tiles[i].compress != tileset->tiles[0].compress)
+        {
+            return COMPRESS_AUTO;
+        }
+    }
+
+    return tileset->numUniqueTiles > 0 ?
+        tileset->tiles[0].compress : COMPRESS_NONE;
+}
+
+/*
+ * Gets the tile map as a byte table of little endian entries, each
+ * tileset_map_entry_size bytes. Returns NULL on memory error.
+ */
+uint8_t *tileset_map_table(const tileset_t *tileset, size_t *size)
+{
+    int entrySize = tileset_map_entry_size(tileset);
+    uint8_t *table;
+    int i;
+
+    table = malloc((size_t)tileset->numTiles * entrySize + 1);
+    if (table == NULL)
+    {
+        return NULL;
     }
 
     for (i = 0; i < tileset->numTiles; ++i)
     {
-        if (tileset->tiles != NULL)
+        table[i * entrySize] = tileset->tileMap[i] & 255;
+        if (entrySize == 2)
         {
-            free(tileset->tiles[i].data);
-            tileset->tiles[i].data = NULL;
+            table[i * entrySize + 1] = (tileset->tileMap[i] >> 8) & 255;
         }
     }
 
+    *size = (size_t)tileset->numTiles * entrySize;
+
+    return table;
+}
+
+/*
+ * Gets the format of each stored tile as a byte table.
+ * Returns NULL on memory error.
+ */
+uint8_t *tileset_compress_table(const tileset_t *tileset)
+{
+    uint8_t *table;
+    int i;
+
+    table = malloc(tileset->numUniqueTiles + 1);
+    if (table == NULL)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < tileset->numUniqueTiles; ++i)
+    {
+        table[i] = tileset->tiles[i].compress;
+    }
+
+    return table;
+}
+
+/*
+ * Frees an allocated tileset.
+ */
+void tileset_free(tileset_t *tileset)
+{
+    if (tileset == NULL)
+    {
+        return;
+    }
+
+    free(tileset->slab);
+    tileset->slab = NULL;
+
     free(tileset->tiles);
     tileset->tiles = NULL;
 
+    free(tileset->tileMap);
+    tileset->tileMap = NULL;
+
+    free(tileset->tileFlags);
+    tileset->tileFlags = NULL;
+
     image_free(&tileset->image);
 }
 
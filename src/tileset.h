@@ -40,10 +40,26 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 
+typedef enum
+{
+    TILESET_DEDUPE_NONE,
+    TILESET_DEDUPE_EXACT,
+    TILESET_DEDUPE_FLIP,
+    TILESET_DEDUPE_ROTATE,
+} tileset_dedupe_t;
+
+/* tile transform flags, transpose is applied first */
+#define TILESET_FLIP_X 1
+#define TILESET_FLIP_Y 2
+#define TILESET_TRANSPOSE 4
+
 typedef struct
 {
     uint8_t *data;
     int size;
+
+    /* set by convert */
+    compress_t compress;
 } tileset_tile_t;
 
 typedef struct
@@ -52,13 +68,23 @@ typedef struct
     int numTiles;
     image_t image;
 
+    /* contiguous storage that tile data points into */
+    uint8_t *slab;
+
+    /* maps each tile number to its stored tile and transform */
+    int *tileMap;
+    uint8_t *tileFlags;
+    int numUniqueTiles;
+
     /* duplicate parameters from parent */
     int tileHeight;
     int tileWidth;
     bool pTable;
+    tileset_dedupe_t dedupe;
 
     /* set by convert */
     bool compressed;
+    bool compressAuto;
 
     /* set by output */
     int appvarIndex;
@@ -72,11 +98,19 @@ typedef struct
     int tileHeight;
     int tileWidth;
     bool pTable;
+    tileset_dedupe_t dedupe;
 } tileset_group_t;
 
 tileset_t *tileset_alloc(void);
 tileset_group_t *tileset_group_alloc(void);
 int tileset_alloc_tiles(tileset_t *tileset);
+void tileset_set_slab(tileset_t *tileset, uint8_t *slab);
+int tileset_dedupe(tileset_t *tileset);
+int tileset_map_entry_size(const tileset_t *tileset);
+bool tileset_has_transforms(const tileset_t *tileset);
+compress_t tileset_compress(const tileset_t *tileset);
+uint8_t *tileset_map_table(const tileset_t *tileset, size_t *size);
+uint8_t *tileset_compress_table(const tileset_t *tileset);
 void tileset_free(tileset_t *tileset);
 void tileset_group_free(tileset_group_t *tilesetGroup);
 
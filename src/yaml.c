@@ -340,6 +340,29 @@ static int yaml_parse_tileset_group(yaml_file_t *yamlfile, char *line, tileset_g
             {
                 tilesetGroup->pTable = !strcmp(value, "true");
             }
+            else if (!strcmp(key, "dedupe"))
+            {
+                if (!strcmp(value, "true") || !strcmp(value, "exact"))
+                {
+                    tilesetGroup->dedupe = TILESET_DEDUPE_EXACT;
+                }
+                else if (!strcmp(value, "flip"))
+                {
+                    tilesetGroup->dedupe = TILESET_DEDUPE_FLIP;
+                }
+                else if (!strcmp(value, "rotate"))
+                {
+                    tilesetGroup->dedupe = TILESET_DEDUPE_ROTATE;
+                }
+                else if (!strcmp(value, "false"))
+                {
+                    tilesetGroup->dedupe = TILESET_DEDUPE_NONE;
+                }
+                else
+                {
+                    goto error;
+                }
+            }
         }
     }
 
@@ -388,6 +411,46 @@ static int yaml_get_command(yaml_file_t *yamlfile, char *command, char *line)
     return ret;
 }
 
+/*
+ * Gets compression mode from string.
+ */
+compress_t yaml_get_compress_mode(yaml_file_t *yamlfile, char *arg)
+{
+    compress_t compress = compress_from_name(arg);
+
+    if (compress == COMPRESS_INVALID)
+    {
+        LL_WARNING("Unknown compression mode (line %d).",
+            yamlfile->line);
+    }
+
+    return compress;
+}
+
+/*
+ * Gets compression level from string.
+ */
+compress_level_t yaml_get_compress_level(yaml_file_t *yamlfile, char *arg)
+{
+    compress_level_t level = COMPRESS_LEVEL_INVALID;
+
+    if (arg != NULL && !strcmp(arg, "optimal"))
+    {
+        level = COMPRESS_LEVEL_OPTIMAL;
+    }
+    else if (arg != NULL && !strcmp(arg, "fast"))
+    {
+        level = COMPRESS_LEVEL_FAST;
+    }
+    else
+    {
+        LL_ERROR("Invalid compression level (line %d).",
+            yamlfile->line);
+    }
+
+    return level;
+}
+
 /*
  * Parses available pallete commands.
  */
@@ -571,11 +634,8 @@ static int yaml_convert_command(yaml_file_t *yamlfile, char *command, char *line
     }
     else if (!strcmp(command, "compress"))
     {
-        if (args != NULL && !strcmp(args, "zx7"))
-        {
-            convert->compress = COMPRESS_ZX7;
-        }
-        else
+        convert->compress = compress_from_name(args);
+        if (convert->compress == COMPRESS_INVALID)
         {
             LL_ERROR("Invalid compression argument for palette \'%s\' (line %d).",
                 convert->name,
@@ -583,6 +643,14 @@ static int yaml_convert_command(yaml_file_t *yamlfile, char *command, char *line
             ret = 1;
         }
     }
+    else if (!strcmp(command, "compress-level"))
+    {
+        convert->compressLevel = yaml_get_compress_level(yamlfile, args);
+        if (convert->compressLevel == COMPRESS_LEVEL_INVALID)
+        {
+            ret = 1;
+        }
+    }
     else if (!strcmp(command, "tilesets"))
     {
         mode = YAML_CONVERT_TILESETS;
@@ -644,6 +712,28 @@ static int yaml_convert_command(yaml_file_t *yamlfile, char *command, char *line
             ret = 1;
         }
     }
+    else if (!strcmp(command, "remap"))
+    {
+        if (args != NULL && !strcmp(args, "direct"))
+        {
+            convert->remap = REMAP_DIRECT;
+        }
+        else if (args != NULL && !strcmp(args, "liq"))
+        {
+            convert->remap = REMAP_LIQ;
+        }
+        else
+        {
+            LL_ERROR("Invalid remap argument for convert \'%s\' (line %d).",
+                convert->name,
+                yamlfile->line);
+            ret = 1;
+        }
+    }
+    else if (!strcmp(command, "dither"))
+    {
+        convert->dither = args != NULL && !strcmp(args, "true");
+    }
     else if (!strcmp(command, "images"))
     {
         mode = YAML_CONVERT_IMAGES;
@@ -661,26 +751,6 @@ static int yaml_convert_command(yaml_file_t *yamlfile, char *command, char *line
     return ret;
 }
 
-/*
- * Gets compression mode from string.
- */
-compress_t yaml_get_compress_mode(yaml_file_t *yamlfile, char *arg)
-{
-    compress_t compress = COMPRESS_INVALID;
-
-    if (!strcmp(arg, "zx7"))
-    {
-        compress = COMPRESS_ZX7;
-    }
-    else
-    {
-        LL_WARNING("Unknown compression mode (line %d).",
-            yamlfile->line);
-    }
-
-    return compress;
-}
-
 /*
  * Parses available conversion commands.
  */
@@ -805,6 +875,27 @@ static int yaml_output_command(yaml_file_t *yamlfile, char *command, char *line)
         {
             output->appvar.compress = yaml_get_compress_mode(yamlfile, args);
         }
+        else if (!strcmp(command, "compress-level"))
+        {
+            output->appvar.compressLevel = yaml_get_compress_level(yamlfile, args);
+            if (output->appvar.compressLevel == COMPRESS_LEVEL_INVALID)
+            {
+                ret = 1;
+            }
+        }
+        else if (!strcmp(command, "compress-groups"))
+        {
+            if (args == NULL)
+            {
+                LL_ERROR("Missing compress-groups value (line %d).",
+                    yamlfile->line);
+                ret = 1;
+            }
+            else
+            {
+                output->appvar.compressGroups = !strcmp(args, "true");
+            }
+        }
         else if (!strcmp(command, "converts"))
         {
             outputMode = YAML_OUTPUT_CONVERTS;